@@ -16,6 +16,8 @@
  ***************************************************************************/
 
 #include <QtGui>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
 
 #include "checkDock.h"
 
@@ -30,6 +32,8 @@
 #include <qgsvertexmarker.h>
 #include <qgsfeature.h>
 #include <qgsmapcanvas.h>
+#include <qgsmaprenderer.h>
+#include <qgscoordinatetransform.h>
 #include <qgsrubberband.h>
 #include <qgsproviderregistry.h>
 #include <qgslogger.h>
@@ -37,6 +41,7 @@
 
 #include "../../app/qgisapp.h"
 
+#include "errorArena.h"
 #include "topolTest.h"
 #include "rulesDialog.h"
 #include "dockModel.h"
@@ -59,9 +64,12 @@ checkDock::checkDock(QgisInterface* qIface, QWidget* parent)
   mErrorTableView->verticalHeader()->setDefaultSectionSize( 20 );
 
   mLayerRegistry = QgsMapLayerRegistry::instance();
+  mProgressDialog = 0;
   mConfigureDialog = new rulesDialog(mLayerRegistry->mapLayers().keys(), mTest.testMap(), qIface, parent);
   mTestTable = mConfigureDialog->testTable();
   
+  mOrderBox->addItems(spatialOrderNames());
+
   mValidateExtentButton->setIcon(QIcon(":/topol_c/topol.png"));
   mValidateAllButton->setIcon(QIcon(":/topol_c/topol.png"));
   mConfigureButton->setIcon(QIcon(":/topol_c/topol.png"));
@@ -90,6 +98,7 @@ checkDock::checkDock(QgisInterface* qIface, QWidget* parent)
   connect(mValidateExtentButton, SIGNAL(clicked()), this, SLOT(validateExtent()));
 
   connect(mFixButton, SIGNAL(clicked()), this, SLOT(fix()));
+  connect(mQuickCheckBox, SIGNAL(toggled(bool)), mMaxErrorsBox, SLOT(setDisabled(bool)));
   connect(mErrorTableView, SIGNAL(clicked(const QModelIndex &)), this, SLOT(errorListClicked(const QModelIndex &)));
 
   connect(mLayerRegistry, SIGNAL(layerWasAdded(QgsMapLayer*)), mConfigureDialog, SLOT(addLayer(QgsMapLayer*)));
@@ -97,11 +106,17 @@ checkDock::checkDock(QgisInterface* qIface, QWidget* parent)
   connect(mLayerRegistry, SIGNAL(layerWillBeRemoved(QString)), this, SLOT(parseErrorListByLayer(QString)));
 
   connect(this, SIGNAL(visibilityChanged(bool)), this, SLOT(updateRubberBands(bool)));
+
+  // tests of the project were read before the dialog could be connected
+  connect(mConfigureDialog, SIGNAL(testsRead()), this, SLOT(warmUp()));
+  warmUp();
 }
 
 checkDock::~checkDock()
 {
-  delete mRBConflict, mRBFeature1, mRBFeature2;
+  delete mRBConflict;
+  delete mRBFeature1;
+  delete mRBFeature2;
   delete mConfigureDialog;
   delete mErrorListModel;
 
@@ -144,16 +159,18 @@ void checkDock::updateRubberBands(bool visible)
 
 void checkDock::deleteErrors()
 {
-  QList<TopolError*>::Iterator it = mErrorList.begin();
-  for (; it != mErrorList.end(); ++it)
-    delete *it;
-
+  // errors removed from the list meanwhile are destroyed with their arenas as well
   mErrorList.clear();
+  qDeleteAll(mArenas);
+  mArenas.clear();
   mErrorListModel->resetModel();
 }
 
 void checkDock::parseErrorListByLayer(QString layerId)
 {
+  // the warm-up may be reading the layer being removed
+  mTest.stopWarmUp();
+
   QgsVectorLayer* layer = (QgsVectorLayer*)mLayerRegistry->mapLayers()[layerId];
   QList<TopolError*>::Iterator it = mErrorList.begin();
   QList<TopolError*>::Iterator end = mErrorList.end();
@@ -290,7 +307,8 @@ void checkDock::errorListClicked(const QModelIndex& index)
     mVMConflict->setCenter(mErrorList[row]->conflict()->asPoint());
   }
   else
-    mRBConflict->setToGeometry(mErrorList[row]->conflict(), fl.layer);
+    // the conflict is computed in the coordinate system of the first layer
+    mRBConflict->setToGeometry(mErrorList[row]->conflict(), mErrorList[row]->featurePairs()[0].layer);
 }
 
 void checkDock::fix()
@@ -321,17 +339,27 @@ void checkDock::fix()
 
 void checkDock::runTests(ValidateType type)
 {
+  QStringList statistics;
+  QList<TestRun*> runs;
+  SpatialOrder order = (SpatialOrder)mOrderBox->currentIndex();
+  bool quickCheck = mQuickCheckBox->isChecked();
+  QMap<QString, test> testMap = mTest.testMap();
+  QMap<QString, TestRun*> groups;
+  int featureCount = 0;
+
   for (int i = 0; i < mTestTable->rowCount(); ++i)
   {
     QString testName = mTestTable->item(i, 0)->text();
     QString toleranceStr = mTestTable->item(i, 3)->text();
     QString layer1Str = mTestTable->item(i, 4)->text();
     QString layer2Str = mTestTable->item(i, 5)->text();
+    IndexType indexType = TopolIndex::typeFromName(mTestTable->item(i, 6)->text());
 
     // test if layer1 is in the registry
     if (!((QgsVectorLayer*)mLayerRegistry->mapLayers().contains(layer1Str)))
     {
       std::cout << "CheckDock: layer " << layer1Str.toStdString() << " not found in registry!" << std::flush;
+      qDeleteAll(runs);
       return;
     }
 
@@ -341,27 +369,196 @@ void checkDock::runTests(ValidateType type)
     if ((QgsVectorLayer*)mLayerRegistry->mapLayers().contains(layer2Str))
       layer2 = (QgsVectorLayer*)mLayerRegistry->mapLayers()[layer2Str];
 
-    QProgressDialog progress(testName, "Abort", 0, layer1->featureCount(), this);
-    progress.setWindowModality(Qt::WindowModal);
+    // rows checking the same features against other layers share one run
+    QString key = QString("%1 %2 %3 %4").arg(testName).arg(layer1Str).arg(toleranceStr).arg((int) indexType);
+    if (layer2 && testMap[testName].useSecondLayer && groups.contains(key))
+    {
+      TestRun* run = groups[key];
+      if (!run->targets().contains(layer2))
+      {
+        run->addTarget(layer2);
+        featureCount += layer1->featureCount();
+      }
+      continue;
+    }
+
+    TestRun* run = new TestRun(testName, layer1, layer2, type, toleranceStr.toDouble(), indexType, order);
+    if (layer2 && testMap[testName].useSecondLayer)
+      groups[key] = run;
 
-    connect(&progress, SIGNAL(canceled()), &mTest, SLOT(setTestCancelled()));
-    connect(&mTest, SIGNAL(progress(int)), &progress, SLOT(setValue(int)));
-    // run the test
+    // a single error is enough to fail the quick check
+    run->setMaxErrors(quickCheck ? 1 : mMaxErrorsBox->value());
+    run->setSampleSize(mSampleBox->value());
+    run->setPartitioned(mPartitionBox->isChecked());
 
-    ErrorList errors = mTest.runTest(testName, layer1, layer2, type, toleranceStr.toDouble());
-    disconnect(&progress, SIGNAL(canceled()), &mTest, SLOT(setTestCancelled()));
-    disconnect(&mTest, SIGNAL(progress(int)), &progress, SLOT(setValue(int)));
-    mErrorList << errors;
+    // the canvas is read here, the tests run in other threads; its extent is
+    // in the map coordinate system when layers are reprojected on the fly
+    if (type == ValidateExtent)
+    {
+      QgsRectangle extent = mQgisApp->mapCanvas()->extent();
+      QgsMapRenderer* renderer = mQgisApp->mapCanvas()->mapRenderer();
+      if (renderer->hasCrsTransformEnabled() && renderer->destinationSrs() != run->workingCrs())
+        extent = QgsCoordinateTransform(renderer->destinationSrs(), run->workingCrs()).transformBoundingBox(extent);
+      run->setExtent(extent);
+    }
+
+    connect(run, SIGNAL(progress(int)), this, SLOT(runProgress(int)));
+    runs << run;
+    featureCount += layer1->featureCount();
   }
+
+  // the runs read the layer providers in other threads, so the canvas does not render
+  // and no window takes input until all of them finish; the dialog is shown at once
+  // because it blocks nothing while hidden
+  QgsMapCanvas* canvas = mQgisApp->mapCanvas();
+  bool frozen = canvas->isFrozen();
+  canvas->freeze(true);
+
+  QProgressDialog progress("Running tests", "Abort", 0, featureCount, this);
+  progress.setWindowModality(Qt::ApplicationModal);
+  progress.setMinimumDuration(0);
+  progress.show();
+  mProgressDialog = &progress;
+  mRunProgress.clear();
+
+  // the tests of the table are independent, they run at once
+  QList<QFuture<ErrorList> > futures;
+  for (int i = 0; i < runs.size(); ++i)
+  {
+    connect(&progress, SIGNAL(canceled()), runs[i], SLOT(cancel()));
+    futures << QtConcurrent::run(&mTest, &topolTest::runTest, runs[i]);
+  }
+
+  // progress of the runs is delivered while waiting
+  QFutureWatcher<ErrorList> watcher;
+  QEventLoop loop;
+  connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+
+  for (int i = 0; i < futures.size(); ++i)
+  {
+    watcher.setFuture(futures[i]);
+    if (!futures[i].isFinished())
+      loop.exec();
+
+    mErrorList << futures[i].result();
+    mArenas << runs[i]->takeArena();
+
+    TestStatistics stats = runs[i]->statistics();
+    if (quickCheck)
+    {
+      if (stats.errorCount)
+        mFailedTests << runs[i]->testName();
+      statistics << QString("%1: %2 in %3 features, test %4 ms")
+                    .arg(runs[i]->testName()).arg(stats.errorCount ? "failed" : "passed")
+                    .arg(stats.featureCount).arg(stats.testTime);
+      continue;
+    }
+
+    if (mSampleBox->value() && testMap[runs[i]->testName()].wholeLayer)
+      statistics << QString("%1: not sampled, the test processes all features anyway").arg(runs[i]->testName());
+
+    if (stats.population)
+      statistics << QString("%1: about %2 errors (95% interval %3 - %4) estimated from %5 of %6 features")
+                    .arg(runs[i]->testName()).arg(qRound(stats.estimatedErrors)).arg(qRound(stats.errorsLow))
+                    .arg(qRound(stats.errorsHigh)).arg(stats.featureCount).arg(stats.population);
+
+    statistics << QString("%1: %2 errors%3 in %4 features, load %5 ms, index %6 ms, order %7 ms, test %8 ms")
+                  .arg(runs[i]->testName()).arg(stats.errorCount).arg(stats.limitReached ? " (limit reached)" : "")
+                  .arg(stats.featureCount).arg(stats.loadTime).arg(stats.indexTime).arg(stats.orderTime).arg(stats.testTime);
+
+    QList<QgsVectorLayer*> targets = runs[i]->targets();
+    if (targets.size() > 1)
+      for (int k = 0; k < stats.targetErrors.size(); ++k)
+        statistics << QString("  %1 errors against %2").arg(stats.targetErrors[k]).arg(targets[k]->name());
+  }
+
+  mProgressDialog = 0;
+  qDeleteAll(runs);
+  canvas->freeze(frozen);
+
+  mComment->setToolTip(statistics.join("\n"));
   mErrorListModel->resetModel();
 }
 
+void checkDock::runProgress(int value)
+{
+  TestRun* run = qobject_cast<TestRun*>(sender());
+  if (!run || !mProgressDialog)
+    return;
+
+  mRunProgress[run] = value;
+
+  int sum = 0;
+  QMap<TestRun*, int>::ConstIterator it = mRunProgress.begin();
+  for (; it != mRunProgress.end(); ++it)
+    sum += *it;
+
+  mProgressDialog->setValue(sum);
+}
+
+void checkDock::warmUp()
+{
+  QMap<QString, test> testMap = mTest.testMap();
+  QList<QgsVectorLayer*> layers;
+  QList<IndexType> types;
+  QList<QgsVectorLayer*> crsLayers;
+
+  for (int i = 0; i < mTestTable->rowCount(); ++i)
+  {
+    if (!mTestTable->item(i, 0))
+      continue;
+
+    QString testName = mTestTable->item(i, 0)->text();
+    IndexType indexType = TopolIndex::typeFromName(mTestTable->item(i, 6)->text());
+    test t = testMap[testName];
+
+    // one layer tests checking features on their own read the first layer
+    // without the cache, partitioned joins never keep the layers in memory
+    if (!t.useSecondLayer && t.perFeature)
+      continue;
+    if (t.join != JoinNone && mPartitionBox->isChecked())
+      continue;
+
+    // two layer tests index the second layer, one layer tests the first one
+    QString layerId = mTestTable->item(i, t.useSecondLayer ? 5 : 4)->text();
+    if (!mLayerRegistry->mapLayers().contains(layerId))
+      continue;
+
+    // second layers are checked in the coordinate system of the first ones
+    QString crsLayerId = mTestTable->item(i, 4)->text();
+    if (!mLayerRegistry->mapLayers().contains(crsLayerId))
+      continue;
+
+    QgsVectorLayer* layer = (QgsVectorLayer*)mLayerRegistry->mapLayers()[layerId];
+    QgsVectorLayer* crsLayer = (QgsVectorLayer*)mLayerRegistry->mapLayers()[crsLayerId];
+
+    bool loaded = false;
+    for (int j = 0; j < layers.size() && !loaded; ++j)
+      loaded = layers[j] == layer && crsLayers[j]->srs() == crsLayer->srs();
+
+    if (!loaded)
+    {
+      layers << layer;
+      types << indexType;
+      crsLayers << crsLayer;
+    }
+  }
+
+  mTest.warmUp(layers, types, crsLayers, (SpatialOrder)mOrderBox->currentIndex());
+}
+
 void checkDock::validate(ValidateType type)
 {
-  mErrorList.clear();
+  deleteErrors();
+  mFailedTests.clear();
 
   runTests(type);
-  mComment->setText(QString("%1 errors were found").arg(mErrorList.count()));
+  if (!mQuickCheckBox->isChecked())
+    mComment->setText(QString("%1 errors were found").arg(mErrorList.count()));
+  else if (mFailedTests.isEmpty())
+    mComment->setText("All tests passed");
+  else
+    mComment->setText(QString("%1 tests failed: %2").arg(mFailedTests.size()).arg(mFailedTests.join(", ")));
 
   mRBFeature1->reset();
   mRBFeature2->reset();
@@ -31,6 +31,8 @@
 #include "topolTest.h"
 #include "dockModel.h"
 
+class ErrorArena;
+class QProgressDialog;
 class QgsMapLayerRegistry;
 class QgsRubberBand;
 class QgsVertexMarker;
@@ -91,6 +93,15 @@ private slots:
    * @param visible true if the window is visible
    */
   void updateRubberBands(bool visible);
+  /**
+   * Shows progress of all running tests in the progress dialog
+   * @param value progress of the test run sending it
+   */
+  void runProgress(int value);
+  /**
+   * Starts loading layers of the test table in background
+   */
+  void warmUp();
 
 
 private:
@@ -105,12 +116,19 @@ private:
   QgsVertexMarker* mVMFeature2;
 
   ErrorList mErrorList;
+  // memory of the errors, released by deleteErrors
+  QList<ErrorArena*> mArenas;
+  // names of the tests failed in the quick check
+  QStringList mFailedTests;
   DockModel* mErrorListModel;
 
   //pointer to topology tests table
   QTableWidget* mTestTable;
 
   topolTest mTest;
+  // dialog of the running tests and the last progress of each run
+  QProgressDialog* mProgressDialog;
+  QMap<TestRun*, int> mRunProgress;
   QgsMapLayerRegistry* mLayerRegistry;
 
   /**
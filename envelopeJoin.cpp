@@ -0,0 +1,83 @@
+/***************************************************************************
+  envelopeJoin.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "envelopeJoin.h"
+
+#include <algorithm>
+
+static bool xMinLessThan(const IndexEntry& a, const IndexEntry& b)
+{
+  return a.xMin < b.xMin;
+}
+
+void EnvelopeJoin::add(int id, const QgsRectangle& bb)
+{
+  IndexEntry e;
+  e.id = id;
+  e.xMin = bb.xMinimum();
+  e.yMin = bb.yMinimum();
+  e.xMax = bb.xMaximum();
+  e.yMax = bb.yMaximum();
+  mEntries << e;
+}
+
+void EnvelopeJoin::prepare()
+{
+  std::sort(mEntries.begin(), mEntries.end(), xMinLessThan);
+}
+
+void EnvelopeJoin::join(int begin, int end, QList<QPair<int, int> >& pairs) const
+{
+  const IndexEntry* entries = mEntries.constData();
+  int count = mEntries.size();
+
+  for (int i = begin; i < end; ++i)
+  {
+    const IndexEntry& a = entries[i];
+
+    // boxes further right start behind the right edge of a
+    for (int j = i + 1; j < count && entries[j].xMin <= a.xMax; ++j)
+    {
+      const IndexEntry& b = entries[j];
+      if (a.yMin <= b.yMax && b.yMin <= a.yMax)
+        pairs << qMakePair(a.id, b.id);
+    }
+  }
+}
+
+QVector<double> EnvelopeJoin::costs(const QVector<int>& weights) const
+{
+  const IndexEntry* entries = mEntries.constData();
+  int count = mEntries.size();
+  QVector<double> result(count);
+
+  for (int i = 0; i < count; ++i)
+  {
+    const IndexEntry& a = entries[i];
+    double cost = weights[a.id];
+
+    for (int j = i + 1; j < count && entries[j].xMin <= a.xMax; ++j)
+    {
+      const IndexEntry& b = entries[j];
+      if (a.yMin <= b.yMax && b.yMin <= a.yMax)
+        cost += weights[a.id] + weights[b.id];
+    }
+    result[i] = cost;
+  }
+
+  return result;
+}
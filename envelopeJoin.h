@@ -0,0 +1,76 @@
+/***************************************************************************
+  envelopeJoin.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef ENVELOPEJOIN_H
+#define ENVELOPEJOIN_H
+
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+#include <qgsrectangle.h>
+
+#include "topolIndex.h"
+
+/**
+ * Finds all pairs of intersecting bounding boxes of one layer by sweeping
+ * the boxes sorted by their left edge, without querying an index per feature.
+ * The sorted positions can be split into strips joined independently.
+ */
+class EnvelopeJoin
+{
+public:
+  /**
+   * Adds a bounding box, must be called before prepare()
+   * @param id entry id
+   * @param bb bounding box of the feature
+   */
+  void add(int id, const QgsRectangle& bb);
+  /**
+   * Sorts the boxes by their left edge
+   */
+  void prepare();
+  /**
+   * Returns number of boxes
+   */
+  int size() const { return mEntries.size(); }
+  /**
+   * Returns id of the box at the sorted position
+   * @param position sorted position
+   */
+  int id(int position) const { return mEntries[position].id; }
+  /**
+   * Appends id pairs of intersecting boxes whose left box lies
+   * at the sorted positions begin..end-1; each pair is found exactly once
+   * @param begin first sorted position
+   * @param end position after the last one
+   * @param pairs list to be filled
+   */
+  void join(int begin, int end, QList<QPair<int, int> >& pairs) const;
+  /**
+   * Returns cost of each sorted position for splitting the positions into
+   * strips: the weight of its box plus the weights of both boxes of every
+   * pair it starts, counted by the same sweep as join() without building pairs
+   * @param weights weight of each box indexed by its id, e.g. vertex count
+   */
+  QVector<double> costs(const QVector<int>& weights) const;
+
+private:
+  QVector<IndexEntry> mEntries;
+};
+
+#endif
@@ -0,0 +1,59 @@
+/***************************************************************************
+  errorArena.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "errorArena.h"
+
+// alignment of the objects placed in the blocks
+static const size_t arenaAlignment = 16;
+
+ErrorArena::ErrorArena(int blockSize)
+{
+  mBlockSize = blockSize;
+  mFree = 0;
+}
+
+ErrorArena::~ErrorArena()
+{
+  for (int i = 0; i < mErrors.size(); ++i)
+    mErrors[i]->~TopolError();
+
+  for (int i = 0; i < mBlocks.size(); ++i)
+    delete [] mBlocks[i];
+}
+
+void* ErrorArena::allocate(size_t size)
+{
+  size = (size + arenaAlignment - 1) / arenaAlignment * arenaAlignment;
+
+  // objects larger than a block get a block of their own
+  if (size > (size_t) mBlockSize)
+  {
+    char* block = new char[size];
+    mBlocks.prepend(block);
+    return block;
+  }
+
+  if (size > (size_t) mFree)
+  {
+    mBlocks << new char[mBlockSize];
+    mFree = mBlockSize;
+  }
+
+  char* p = mBlocks.last() + (mBlockSize - mFree);
+  mFree -= size;
+  return p;
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+  errorArena.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef ERRORARENA_H
+#define ERRORARENA_H
+
+#include <QList>
+
+#include <new>
+
+#include "topolError.h"
+
+/**
+ * Memory of the errors found by one run. Errors are placed one after
+ * another in large blocks, so that runs going on at once do not compete
+ * for the heap, and they are all destroyed with the arena, including
+ * those already removed from the error list. The arena is used only by
+ * the thread running the test.
+ */
+class ErrorArena
+{
+public:
+  /**
+   * Constructor
+   * @param blockSize size of the memory blocks in bytes
+   */
+  ErrorArena(int blockSize = 64 * 1024);
+  /**
+   * Destroys all errors of the arena and frees its memory
+   */
+  ~ErrorArena();
+
+  /**
+   * Creates an error in the arena, the error must not be deleted
+   * @param bb bounding box of the error
+   * @param conflict conflicting geometry, owned by the error
+   * @param fls features of the error
+   */
+  template <class T>
+  T* create(const QgsRectangle& bb, QgsGeometry* conflict, const QList<FeatureLayer>& fls)
+  {
+    T* error = new (allocate(sizeof(T))) T(bb, conflict, fls);
+    mErrors << error;
+    return error;
+  }
+  /**
+   * Returns number of errors created in the arena
+   */
+  int size() const { return mErrors.size(); }
+
+private:
+  int mBlockSize;
+  QList<char*> mBlocks;
+  // free bytes of the last block
+  int mFree;
+  QList<TopolError*> mErrors;
+
+  /**
+   * Returns memory for an object of the size
+   * @param size object size in bytes
+   */
+  void* allocate(size_t size);
+
+  ErrorArena(const ErrorArena&);
+  ErrorArena& operator=(const ErrorArena&);
+};
+
+#endif
@@ -0,0 +1,129 @@
+/***************************************************************************
+  featureQueue.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "featureQueue.h"
+
+#include <QMutexLocker>
+
+FeatureQueue::FeatureQueue(int capacity)
+{
+  mCapacity = capacity;
+  mFinished = false;
+  mClosed = false;
+}
+
+bool FeatureQueue::push(const QgsFeatureList& batch)
+{
+  QMutexLocker locker(&mMutex);
+  while (mBatches.size() >= mCapacity && !mClosed)
+    mNotFull.wait(&mMutex);
+
+  if (mClosed)
+    return false;
+
+  mBatches << batch;
+  mNotEmpty.wakeOne();
+  return true;
+}
+
+bool FeatureQueue::pop(QgsFeatureList& batch)
+{
+  QMutexLocker locker(&mMutex);
+  while (mBatches.isEmpty() && !mFinished)
+    mNotEmpty.wait(&mMutex);
+
+  if (mBatches.isEmpty())
+    return false;
+
+  batch = mBatches.takeFirst();
+  mNotFull.wakeOne();
+  return true;
+}
+
+void FeatureQueue::finish()
+{
+  QMutexLocker locker(&mMutex);
+  mFinished = true;
+  mNotEmpty.wakeAll();
+}
+
+void FeatureQueue::close()
+{
+  QMutexLocker locker(&mMutex);
+  mClosed = true;
+  mBatches.clear();
+  mNotFull.wakeAll();
+}
+
+FeatureReader::FeatureReader(QgsVectorLayer* layer, const QgsRectangle& extent, FeatureQueue* queue, int batchSize)
+{
+  mLayer = layer;
+  mExtent = extent;
+  mQueue = queue;
+  mBatchSize = batchSize;
+  mTransform = 0;
+}
+
+FeatureReader::~FeatureReader()
+{
+  delete mTransform;
+}
+
+void FeatureReader::setDestinationCrs(const QgsCoordinateReferenceSystem& destination)
+{
+  delete mTransform;
+  mTransform = 0;
+
+  if (destination.isValid() && destination != mLayer->srs())
+    mTransform = new QgsCoordinateTransform(mLayer->srs(), destination);
+}
+
+void FeatureReader::run()
+{
+  read();
+}
+
+void FeatureReader::read()
+{
+  // the extent is given in the destination coordinates
+  QgsRectangle extent = mExtent;
+  if (mTransform && !extent.isEmpty())
+    extent = mTransform->transformBoundingBox(extent, QgsCoordinateTransform::ReverseTransform);
+
+  mLayer->select(QgsAttributeList(), extent);
+
+  QgsFeatureList batch;
+  QgsFeature f;
+  while (mLayer->nextFeature(f))
+  {
+    if (mTransform && f.geometry())
+      f.geometry()->transform(*mTransform);
+
+    batch << f;
+    if (batch.size() < mBatchSize)
+      continue;
+
+    if (!mQueue->push(batch))
+      break;
+    batch.clear();
+  }
+
+  if (!batch.isEmpty())
+    mQueue->push(batch);
+
+  mQueue->finish();
+}
@@ -0,0 +1,117 @@
+/***************************************************************************
+  featureQueue.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef FEATUREQUEUE_H
+#define FEATUREQUEUE_H
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <qgscoordinatetransform.h>
+#include <qgsvectorlayer.h>
+#include <qgsfeature.h>
+#include <qgsrectangle.h>
+
+/**
+ * Bounded queue of feature batches passed from the thread reading
+ * a data provider to the thread processing the features
+ */
+class FeatureQueue
+{
+public:
+  /**
+   * Constructor
+   * @param capacity number of batches the reader may get ahead
+   */
+  FeatureQueue(int capacity = 16);
+
+  /**
+   * Appends a batch, waits while the queue is full
+   * Returns false once the consumer closed the queue.
+   * @param batch features read
+   */
+  bool push(const QgsFeatureList& batch);
+  /**
+   * Takes the oldest batch, waits while the queue is empty
+   * Returns false when the reader finished and all batches were taken.
+   * @param batch list to be filled
+   */
+  bool pop(QgsFeatureList& batch);
+  /**
+   * Tells the consumer no more batches will come
+   */
+  void finish();
+  /**
+   * Tells the reader to stop, the remaining batches are dropped
+   */
+  void close();
+
+private:
+  QList<QgsFeatureList> mBatches;
+  int mCapacity;
+  bool mFinished;
+  bool mClosed;
+  QMutex mMutex;
+  QWaitCondition mNotEmpty;
+  QWaitCondition mNotFull;
+};
+
+/**
+ * Thread reading features of a layer into a queue, so that the provider
+ * is read while the features read so far are processed. The caller must
+ * keep other threads off the layer until the reader is finished.
+ */
+class FeatureReader : public QThread
+{
+public:
+  /**
+   * Constructor
+   * @param layer pointer to the layer
+   * @param extent read features in the extent, an empty rectangle for all of them
+   * @param queue queue the batches are appended to
+   * @param batchSize number of features per batch
+   */
+  FeatureReader(QgsVectorLayer* layer, const QgsRectangle& extent, FeatureQueue* queue, int batchSize = 256);
+  ~FeatureReader();
+
+  /**
+   * Makes the reader transform geometries into another coordinate system,
+   * the batches are transformed in the reader thread while the previous ones are processed
+   * @param destination coordinate system of the read geometries and of the extent
+   */
+  void setDestinationCrs(const QgsCoordinateReferenceSystem& destination);
+  /**
+   * Reads the features in the calling thread instead of a started one,
+   * the queue must be large enough to take all batches
+   */
+  void read();
+
+protected:
+  void run();
+
+private:
+  QgsVectorLayer* mLayer;
+  QgsRectangle mExtent;
+  FeatureQueue* mQueue;
+  int mBatchSize;
+  // transformation from the layer coordinates, null if not needed
+  QgsCoordinateTransform* mTransform;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/***************************************************************************
+  featureSample.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "featureSample.h"
+
+#include <cmath>
+
+#include <qgsvectorlayer.h>
+
+// features per stratum, at least two are needed to estimate its variance
+static const int featuresPerStratum = 8;
+
+/**
+ * Returns next number of a 64 bit linear congruential generator,
+ * qrand() gives just 15 bits where RAND_MAX is 32767
+ * @param state generator state, advanced
+ */
+static quint64 nextRandom(quint64& state)
+{
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  // the low bits have short periods
+  return state >> 16;
+}
+
+FeatureSample::FeatureSample(int sampleSize, uint seed)
+{
+  mSampleSize = sampleSize;
+  mSeed = seed;
+  mPopulation = 0;
+}
+
+void FeatureSample::draw(QList<FeatureLayer>& features)
+{
+  mPopulation = features.size();
+  mStrata.clear();
+  mSampled.clear();
+
+  if (mSampleSize <= 0 || features.size() <= mSampleSize)
+    return;
+
+  QVector<QgsPoint> centers(features.size());
+  QgsRectangle extent;
+  extent.setMinimal();
+  for (int i = 0; i < features.size(); ++i)
+  {
+    centers[i] = features[i].feature.geometry()->boundingBox().center();
+    extent.combineExtentWith(centers[i].x(), centers[i].y());
+  }
+
+  int side = qMax(1, (int) sqrt((double) mSampleSize / featuresPerStratum));
+  double width = qMax(extent.width(), 1e-12);
+  double height = qMax(extent.height(), 1e-12);
+
+  QVector<QVector<int> > strata(side * side);
+  for (int i = 0; i < features.size(); ++i)
+  {
+    int col = qMin(side - 1, (int) ((centers[i].x() - extent.xMinimum()) / width * side));
+    int row = qMin(side - 1, (int) ((centers[i].y() - extent.yMinimum()) / height * side));
+    strata[row * side + col] << i;
+  }
+
+  quint64 random = mSeed;
+
+  QList<FeatureLayer> sample;
+  for (int s = 0; s < strata.size(); ++s)
+  {
+    QVector<int>& members = strata[s];
+    if (members.isEmpty())
+      continue;
+
+    // proportional allocation, small strata are taken as a whole
+    int count = qRound((double) mSampleSize * members.size() / features.size());
+    count = qMin(members.size(), qMax(2, count));
+
+    int stratum = mStrata.size();
+    mStrata << members.size();
+
+    // partial Fisher-Yates shuffle, the first count members form the sample
+    for (int k = 0; k < count; ++k)
+    {
+      int r = k + (int) (nextRandom(random) % (members.size() - k));
+      qSwap(members[k], members[r]);
+
+      const FeatureLayer& fl = features[members[k]];
+      mSampled[fl.feature.id()] = stratum;
+      sample << fl;
+    }
+  }
+
+  features = sample;
+}
+
+SampleEstimate FeatureSample::estimate(const ErrorList& errors, QgsVectorLayer* layer) const
+{
+  SampleEstimate result;
+  result.errors = errors.size();
+  result.low = result.high = result.errors;
+
+  if (!isSampled())
+    return result;
+
+  // errors per sampled feature
+  QMap<int, double> shares;
+  for (int e = 0; e < errors.size(); ++e)
+  {
+    QList<FeatureLayer> fls = errors[e]->featurePairs();
+    QList<int> ids;
+    for (int i = 0; i < fls.size(); ++i)
+      if (fls[i].layer == layer && !ids.contains(fls[i].feature.id()))
+        ids << fls[i].feature.id();
+
+    for (int i = 0; i < ids.size(); ++i)
+      if (mSampled.contains(ids[i]))
+        shares[ids[i]] += 1.0 / ids.size();
+  }
+
+  QVector<double> sum(mStrata.size(), 0);
+  QVector<double> sqrSum(mStrata.size(), 0);
+  QVector<int> count(mStrata.size(), 0);
+
+  QMap<int, int>::ConstIterator it = mSampled.begin();
+  for (; it != mSampled.end(); ++it)
+  {
+    double y = shares.value(it.key());
+    sum[*it] += y;
+    sqrSum[*it] += y * y;
+    ++count[*it];
+  }
+
+  // stratified estimate of the total with the finite population correction
+  double total = 0;
+  double variance = 0;
+  for (int s = 0; s < mStrata.size(); ++s)
+  {
+    int n = count[s];
+    int N = mStrata[s];
+    double mean = sum[s] / n;
+    total += N * mean;
+
+    if (n > 1 && n < N)
+    {
+      double s2 = (sqrSum[s] - n * mean * mean) / (n - 1);
+      variance += (double) N * N * (1 - (double) n / N) * qMax(0.0, s2) / n;
+    }
+  }
+
+  double margin = 1.96 * sqrt(variance);
+  result.errors = total;
+  result.low = qMax(0.0, total - margin);
+  result.high = total + margin;
+  return result;
+}
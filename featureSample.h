@@ -0,0 +1,88 @@
+/***************************************************************************
+  featureSample.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef FEATURESAMPLE_H
+#define FEATURESAMPLE_H
+
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+#include "topolError.h"
+
+class QgsVectorLayer;
+
+class SampleEstimate
+{
+public:
+  // estimated number of errors in all features
+  double errors;
+  // 95% confidence interval of the estimate
+  double low;
+  double high;
+};
+
+/**
+ * Stratified random sample of the checked features. Features are split
+ * into strata by a regular grid over their extent and every stratum gets
+ * its share of the sample, so that all parts of the layer are checked.
+ * Errors found in the sample are scaled to the whole layer.
+ */
+class FeatureSample
+{
+public:
+  /**
+   * Constructor
+   * @param sampleSize wanted number of sampled features
+   * @param seed seed of the random generator, the same seed draws the same sample
+   */
+  FeatureSample(int sampleSize, uint seed = 1);
+
+  /**
+   * Replaces the features by their sample, nothing is done
+   * if there are not more features than the sample size
+   * @param features features to be checked
+   */
+  void draw(QList<FeatureLayer>& features);
+  /**
+   * Returns true if the features were sampled
+   */
+  bool isSampled() const { return !mStrata.isEmpty(); }
+  /**
+   * Returns number of features the sample was drawn from
+   */
+  int population() const { return mPopulation; }
+  /**
+   * Estimates number of errors in all features. An error is shared by
+   * the features of the layer it refers to, so errors of two checked
+   * features are not counted twice.
+   * @param errors errors found in the sample
+   * @param layer layer the sample was drawn from
+   */
+  SampleEstimate estimate(const ErrorList& errors, QgsVectorLayer* layer) const;
+
+private:
+  int mSampleSize;
+  uint mSeed;
+  int mPopulation;
+  // size of every stratum in the population
+  QVector<int> mStrata;
+  // sampled feature id to its stratum
+  QMap<int, int> mSampled;
+};
+
+#endif
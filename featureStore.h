@@ -0,0 +1,69 @@
+/***************************************************************************
+  featureStore.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef FEATURESTORE_H
+#define FEATURESTORE_H
+
+#include <QHash>
+#include <QVector>
+
+#include "topolError.h"
+
+/**
+ * Features of a layer stored in a vector and addressed by compact
+ * indexes 0..size()-1, which are also the ids kept in the spatial index
+ */
+class FeatureStore
+{
+public:
+  /**
+   * Appends a feature and returns its index
+   * @param fl feature and its layer
+   */
+  int add(const FeatureLayer& fl)
+  {
+    mIndexes[fl.feature.id()] = mFeatures.size();
+    mFeatures << fl;
+    return mFeatures.size() - 1;
+  }
+  /**
+   * Returns the feature stored at the index
+   * @param index compact feature index
+   */
+  FeatureLayer& operator[](int index) { return mFeatures[index]; }
+  const FeatureLayer& operator[](int index) const { return mFeatures[index]; }
+  /**
+   * Returns the compact index of the feature id, -1 if it is not stored
+   * @param featureId feature id
+   */
+  int indexOf(int featureId) const { return mIndexes.value(featureId, -1); }
+  /**
+   * Returns number of stored features
+   */
+  int size() const { return mFeatures.size(); }
+  /**
+   * Reserves space for the given number of features
+   * @param count expected feature count
+   */
+  void reserve(int count) { mFeatures.reserve(count); mIndexes.reserve(count); }
+
+private:
+  QVector<FeatureLayer> mFeatures;
+  QHash<int, int> mIndexes;
+};
+
+#endif
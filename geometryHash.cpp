@@ -0,0 +1,212 @@
+/***************************************************************************
+  geometryHash.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "geometryHash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "nativeFunctions.h"
+
+typedef QVector<qint64> KeySequence;
+
+// orders key sequences lexicographically
+static bool sequenceLessThan(const KeySequence& a, const KeySequence& b)
+{
+  return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+}
+
+/**
+ * Returns key of the coordinate: the grid cell with a tolerance, the bit pattern without it
+ */
+static qint64 coordinateKey(double d, double tolerance)
+{
+  if (tolerance > 0)
+    return (qint64) floor(d / tolerance + 0.5);
+
+  // make -0 and 0 the same key
+  d += 0.0;
+  qint64 key;
+  memcpy(&key, &d, sizeof(key));
+  return key;
+}
+
+/**
+ * Returns x, y keys of the vertices with repeated vertices removed
+ */
+static KeySequence vertexKeys(const QgsPolyline& line, double tolerance)
+{
+  KeySequence keys;
+  keys.reserve(2 * line.size());
+  for (int i = 0; i < line.size(); ++i)
+  {
+    qint64 x = coordinateKey(line[i].x(), tolerance);
+    qint64 y = coordinateKey(line[i].y(), tolerance);
+    int n = keys.size();
+    if (n && keys[n-2] == x && keys[n-1] == y)
+      continue;
+    keys << x << y;
+  }
+  return keys;
+}
+
+/**
+ * Returns keys of the line running from its lower end
+ */
+static KeySequence normalizedLine(const QgsPolyline& line, double tolerance)
+{
+  KeySequence keys = vertexKeys(line, tolerance);
+  int n = keys.size() / 2;
+
+  QVector<qint64> reversed(keys.size());
+  for (int i = 0; i < n; ++i)
+  {
+    reversed[2*i] = keys[2*(n-1-i)];
+    reversed[2*i+1] = keys[2*(n-1-i)+1];
+  }
+
+  return sequenceLessThan(reversed, keys) ? reversed : keys;
+}
+
+/**
+ * Returns keys of the ring oriented as requested, starting at its lowest vertex,
+ * without the closing vertex
+ */
+static KeySequence normalizedRing(const QgsPolyline& ring, bool counterClockwise, double tolerance)
+{
+  QgsPolyline oriented = ring;
+  if ((ringArea(ring) > 0) != counterClockwise)
+    std::reverse(oriented.begin(), oriented.end());
+
+  KeySequence keys = vertexKeys(oriented, tolerance);
+  int n = keys.size() / 2;
+  if (n > 1 && keys[0] == keys[2*n-2] && keys[1] == keys[2*n-1])
+  {
+    keys.resize(2 * (n - 1));
+    --n;
+  }
+
+  int start = 0;
+  for (int i = 1; i < n; ++i)
+    if (keys[2*i] < keys[2*start] || (keys[2*i] == keys[2*start] && keys[2*i+1] < keys[2*start+1]))
+      start = i;
+
+  KeySequence rotated(keys.size());
+  for (int i = 0; i < n; ++i)
+  {
+    rotated[2*i] = keys[2*((start+i) % n)];
+    rotated[2*i+1] = keys[2*((start+i) % n)+1];
+  }
+  return rotated;
+}
+
+/**
+ * Returns keys of the polygon, exterior ring counter-clockwise followed by sorted holes
+ */
+static KeySequence normalizedPolygon(const QgsPolygon& polygon, double tolerance)
+{
+  KeySequence keys;
+  if (polygon.isEmpty())
+    return keys;
+
+  QList<KeySequence> holes;
+  for (int i = 1; i < polygon.size(); ++i)
+    holes << normalizedRing(polygon[i], false, tolerance);
+  std::sort(holes.begin(), holes.end(), sequenceLessThan);
+
+  KeySequence exterior = normalizedRing(polygon[0], true, tolerance);
+  keys << polygon.size() << exterior.size();
+  keys += exterior;
+  for (int i = 0; i < holes.size(); ++i)
+  {
+    keys << holes[i].size();
+    keys += holes[i];
+  }
+  return keys;
+}
+
+NormalizedGeometry::NormalizedGeometry(QgsGeometry* g, double tolerance)
+{
+  QList<KeySequence> parts;
+  QgsMultiPoint mp;
+  QgsMultiPolyline mls;
+  QgsMultiPolygon mpol;
+  QGis::GeometryType type = QGis::UnknownGeometry;
+
+  switch (g->wkbType())
+  {
+    case QGis::WKBPoint:
+    case QGis::WKBPoint25D:
+      type = QGis::Point;
+      parts << vertexKeys(QgsPolyline() << g->asPoint(), tolerance);
+    break;
+
+    case QGis::WKBMultiPoint:
+    case QGis::WKBMultiPoint25D:
+      type = QGis::Point;
+      mp = g->asMultiPoint();
+      for (int i = 0; i < mp.size(); ++i)
+        parts << vertexKeys(QgsPolyline() << mp[i], tolerance);
+    break;
+
+    case QGis::WKBLineString:
+    case QGis::WKBLineString25D:
+      type = QGis::Line;
+      parts << normalizedLine(g->asPolyline(), tolerance);
+    break;
+
+    case QGis::WKBMultiLineString:
+    case QGis::WKBMultiLineString25D:
+      type = QGis::Line;
+      mls = g->asMultiPolyline();
+      for (int i = 0; i < mls.size(); ++i)
+        parts << normalizedLine(mls[i], tolerance);
+    break;
+
+    case QGis::WKBPolygon:
+    case QGis::WKBPolygon25D:
+      type = QGis::Polygon;
+      parts << normalizedPolygon(g->asPolygon(), tolerance);
+    break;
+
+    case QGis::WKBMultiPolygon:
+    case QGis::WKBMultiPolygon25D:
+      type = QGis::Polygon;
+      mpol = g->asMultiPolygon();
+      for (int i = 0; i < mpol.size(); ++i)
+        parts << normalizedPolygon(mpol[i], tolerance);
+    break;
+
+    default:
+    break;
+  }
+
+  // single and multipart geometries with the same parts are equal
+  std::sort(parts.begin(), parts.end(), sequenceLessThan);
+
+  mValues << type << parts.size();
+  for (int i = 0; i < parts.size(); ++i)
+  {
+    mValues << parts[i].size();
+    mValues += parts[i];
+  }
+
+  mHash = 0;
+  for (int i = 0; i < mValues.size(); ++i)
+    mHash ^= qHash(mValues[i]) + 0x9e3779b9 + (mHash << 6) + (mHash >> 2);
+}
@@ -0,0 +1,51 @@
+/***************************************************************************
+  geometryHash.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef GEOMETRYHASH_H
+#define GEOMETRYHASH_H
+
+#include <QVector>
+
+#include <qgsgeometry.h>
+
+/**
+ * Geometry reduced to a canonical sequence of coordinates, equal for
+ * geometries differing only in ring orientation, ring start vertex,
+ * line direction or order of parts.
+ * With a tolerance the coordinates are snapped to a grid of that size
+ * and repeated vertices are dropped, so near duplicates compare equal too.
+ */
+class NormalizedGeometry
+{
+public:
+  /**
+   * Constructor
+   * @param g geometry
+   * @param tolerance grid size of the coordinates, 0 to compare them exactly
+   */
+  NormalizedGeometry(QgsGeometry* g, double tolerance);
+
+  uint hash() const { return mHash; }
+  bool operator==(const NormalizedGeometry& other) const { return mValues == other.mValues; }
+
+private:
+  // geometry type, part and ring sizes followed by coordinate keys
+  QVector<qint64> mValues;
+  uint mHash;
+};
+
+#endif
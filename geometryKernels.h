@@ -0,0 +1,439 @@
+/***************************************************************************
+  geometryKernels.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef GEOMETRYKERNELS_H
+#define GEOMETRYKERNELS_H
+
+#include <qgis.h>
+#include <qgsgeometry.h>
+
+#include "geosContext.h"
+#include "lineNoder.h"
+#include "nativeFunctions.h"
+
+/*
+ * Predicates specialized for pairs of geometry types. The generic kernel
+ * calls GEOS, the specializations work on native coordinates and turn to
+ * GEOS or the line noder only for large geometries. Callers pass the GEOS
+ * context of their thread, so that GEOS is called only through its reentrant API.
+ */
+
+// segment pairs compared one by one, larger geometries are left to GEOS or the noder
+static const double nativePairLimit = 65536;
+
+/**
+ * Returns number of segments of the polylines
+ * @param parts polylines
+ */
+inline double segmentCount(const QList<QgsPolyline>& parts)
+{
+  double count = 0;
+  for (int i = 0; i < parts.size(); ++i)
+    count += qMax(0, parts[i].size() - 1);
+  return count;
+}
+
+/**
+ * Checks whether some segments of the two polyline sets intersect or touch
+ * @param parts1 first polylines
+ * @param parts2 second polylines
+ */
+inline bool partsIntersect(const QList<QgsPolyline>& parts1, const QList<QgsPolyline>& parts2)
+{
+  if (segmentCount(parts1) * segmentCount(parts2) > nativePairLimit)
+  {
+    // large geometries are noded in one sweep
+    LineNoder noder(true);
+    for (int k = 0; k < parts1.size(); ++k)
+      noder.addPolyline(parts1[k], 0, 0, k);
+    for (int k = 0; k < parts2.size(); ++k)
+      noder.addPolyline(parts2[k], 1, 1, k);
+    return !noder.intersections().isEmpty();
+  }
+
+  QgsPoint i1, i2;
+  for (int k = 0; k < parts1.size(); ++k)
+    for (int l = 0; l < parts2.size(); ++l)
+      for (int i = 1; i < parts1[k].size(); ++i)
+        for (int j = 1; j < parts2[l].size(); ++j)
+          if (segmentIntersection(parts1[k][i-1], parts1[k][i], parts2[l][j-1], parts2[l][j], i1, i2))
+            return true;
+
+  return false;
+}
+
+/**
+ * Checks whether some segments of the two polyline sets are closer than the tolerance
+ * @param parts1 first polylines
+ * @param parts2 second polylines
+ * @param tolerance distance
+ */
+inline bool partsWithin(const QList<QgsPolyline>& parts1, const QList<QgsPolyline>& parts2, double tolerance)
+{
+  double sqrTolerance = tolerance * tolerance;
+  for (int k = 0; k < parts1.size(); ++k)
+    for (int l = 0; l < parts2.size(); ++l)
+      for (int i = 1; i < parts1[k].size(); ++i)
+      {
+        const QgsPoint& a = parts1[k][i-1];
+        const QgsPoint& b = parts1[k][i];
+        for (int j = 1; j < parts2[l].size(); ++j)
+        {
+          const QgsPoint& c = parts2[l][j-1];
+          const QgsPoint& d = parts2[l][j];
+
+          // segments whose boxes are farther apart than the tolerance are skipped
+          if (qMax(c.x(), d.x()) < qMin(a.x(), b.x()) - tolerance || qMin(c.x(), d.x()) > qMax(a.x(), b.x()) + tolerance ||
+              qMax(c.y(), d.y()) < qMin(a.y(), b.y()) - tolerance || qMin(c.y(), d.y()) > qMax(a.y(), b.y()) + tolerance)
+            continue;
+
+          if (sqrSegmentDistance(a, b, c, d) < sqrTolerance)
+            return true;
+        }
+      }
+
+  return false;
+}
+
+/**
+ * Checks whether some point lies on the polylines or closer than the tolerance
+ * @param points points
+ * @param parts polylines
+ * @param tolerance distance, 0 for points lying on the polylines
+ */
+inline bool pointsNearParts(const QgsMultiPoint& points, const QList<QgsPolyline>& parts, double tolerance)
+{
+  double sqrTolerance = tolerance * tolerance;
+  for (int p = 0; p < points.size(); ++p)
+    for (int k = 0; k < parts.size(); ++k)
+    {
+      if (tolerance <= 0)
+      {
+        if (pointOnLine(points[p], parts[k], 0))
+          return true;
+        continue;
+      }
+
+      for (int i = 1; i < parts[k].size(); ++i)
+        if (sqrDistToSegment(points[p], parts[k][i-1], parts[k][i]) < sqrTolerance)
+          return true;
+    }
+
+  return false;
+}
+
+/**
+ * Checks whether the first vertex of some polyline lies inside the polygon,
+ * which tells whether polylines not crossing the polygon boundary lie inside
+ * @param parts polylines or rings
+ * @param polygon polygon geometry
+ */
+inline bool partStartInPolygon(const QList<QgsPolyline>& parts, QgsGeometry* polygon)
+{
+  for (int k = 0; k < parts.size(); ++k)
+    if (!parts[k].isEmpty() && pointInPolygon(parts[k].first(), polygon))
+      return true;
+
+  return false;
+}
+
+/**
+ * Checks whether the geometries intersect using GEOS
+ * @param geos GEOS context of the calling thread
+ */
+inline bool geosIntersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos)
+{
+  return geos->intersects(g1, g2);
+}
+
+/**
+ * Checks whether the geometries are closer than the tolerance using GEOS,
+ * geometries whose distance cannot be computed are not close
+ * @param geos GEOS context of the calling thread
+ */
+inline bool geosWithinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos)
+{
+  double distance = geos->distance(g1, g2);
+  return distance >= 0 && distance < tolerance;
+}
+
+/**
+ * Generic kernel for geometry types without a native one
+ */
+template <QGis::GeometryType Type1, QGis::GeometryType Type2>
+class GeometryKernel
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) { return geosIntersects(g1, g2, geos); }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) { return geosWithinDistance(g1, g2, tolerance, geos); }
+};
+
+template <>
+class GeometryKernel<QGis::Point, QGis::Point>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) { return near(g1, g2, 0); }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) { return tolerance > 0 && near(g1, g2, tolerance); }
+
+private:
+  static bool near(QgsGeometry* g1, QgsGeometry* g2, double tolerance)
+  {
+    QgsMultiPoint points1 = pointParts(g1);
+    QgsMultiPoint points2 = pointParts(g2);
+    double sqrTolerance = tolerance * tolerance;
+
+    for (int i = 0; i < points1.size(); ++i)
+      for (int j = 0; j < points2.size(); ++j)
+        if (tolerance > 0 ? points1[i].sqrDist(points2[j]) < sqrTolerance : points1[i] == points2[j])
+          return true;
+
+    return false;
+  }
+};
+
+template <>
+class GeometryKernel<QGis::Point, QGis::Line>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos)
+  {
+    QList<QgsPolyline> lines;
+    linearParts(g2, lines);
+    return pointsNearParts(pointParts(g1), lines, 0);
+  }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos)
+  {
+    QList<QgsPolyline> lines;
+    linearParts(g2, lines);
+    return tolerance > 0 && pointsNearParts(pointParts(g1), lines, tolerance);
+  }
+};
+
+template <>
+class GeometryKernel<QGis::Point, QGis::Polygon>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) { return near(g1, g2, 0); }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) { return tolerance > 0 && near(g1, g2, tolerance); }
+
+private:
+  static bool near(QgsGeometry* g1, QgsGeometry* g2, double tolerance)
+  {
+    QgsMultiPoint points = pointParts(g1);
+    for (int p = 0; p < points.size(); ++p)
+      if (pointInPolygon(points[p], g2))
+        return true;
+
+    // points on the boundary or near it
+    QList<QgsPolyline> rings;
+    linearParts(g2, rings);
+    return pointsNearParts(points, rings, tolerance);
+  }
+};
+
+template <>
+class GeometryKernel<QGis::Line, QGis::Line>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos)
+  {
+    QList<QgsPolyline> lines1, lines2;
+    linearParts(g1, lines1);
+    linearParts(g2, lines2);
+    return partsIntersect(lines1, lines2);
+  }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos)
+  {
+    if (tolerance <= 0)
+      return false;
+
+    QList<QgsPolyline> lines1, lines2;
+    linearParts(g1, lines1);
+    linearParts(g2, lines2);
+    if (segmentCount(lines1) * segmentCount(lines2) > nativePairLimit)
+      return geosWithinDistance(g1, g2, tolerance, geos);
+
+    return partsWithin(lines1, lines2, tolerance);
+  }
+};
+
+template <>
+class GeometryKernel<QGis::Line, QGis::Polygon>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos)
+  {
+    QList<QgsPolyline> lines, rings;
+    linearParts(g1, lines);
+    linearParts(g2, rings);
+    return partsIntersect(lines, rings) || partStartInPolygon(lines, g2);
+  }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos)
+  {
+    if (tolerance <= 0)
+      return false;
+
+    QList<QgsPolyline> lines, rings;
+    linearParts(g1, lines);
+    linearParts(g2, rings);
+    if (segmentCount(lines) * segmentCount(rings) > nativePairLimit)
+      return geosWithinDistance(g1, g2, tolerance, geos);
+
+    return partStartInPolygon(lines, g2) || partsWithin(lines, rings, tolerance);
+  }
+};
+
+template <>
+class GeometryKernel<QGis::Polygon, QGis::Polygon>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos)
+  {
+    QList<QgsPolyline> rings1, rings2;
+    linearParts(g1, rings1);
+    linearParts(g2, rings2);
+
+    // without crossing boundaries one polygon may still lie inside the other
+    return partsIntersect(rings1, rings2) || partStartInPolygon(rings1, g2) || partStartInPolygon(rings2, g1);
+  }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos)
+  {
+    if (tolerance <= 0)
+      return false;
+
+    QList<QgsPolyline> rings1, rings2;
+    linearParts(g1, rings1);
+    linearParts(g2, rings2);
+    if (segmentCount(rings1) * segmentCount(rings2) > nativePairLimit)
+      return geosWithinDistance(g1, g2, tolerance, geos);
+
+    return partStartInPolygon(rings1, g2) || partStartInPolygon(rings2, g1) || partsWithin(rings1, rings2, tolerance);
+  }
+};
+
+// both predicates are symmetric, swapped pairs use the kernels above
+
+template <>
+class GeometryKernel<QGis::Line, QGis::Point>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) { return GeometryKernel<QGis::Point, QGis::Line>::intersects(g2, g1, geos); }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) { return GeometryKernel<QGis::Point, QGis::Line>::withinDistance(g2, g1, tolerance, geos); }
+};
+
+template <>
+class GeometryKernel<QGis::Polygon, QGis::Point>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) { return GeometryKernel<QGis::Point, QGis::Polygon>::intersects(g2, g1, geos); }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) { return GeometryKernel<QGis::Point, QGis::Polygon>::withinDistance(g2, g1, tolerance, geos); }
+};
+
+template <>
+class GeometryKernel<QGis::Polygon, QGis::Line>
+{
+public:
+  static bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) { return GeometryKernel<QGis::Line, QGis::Polygon>::intersects(g2, g1, geos); }
+  static bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) { return GeometryKernel<QGis::Line, QGis::Polygon>::withinDistance(g2, g1, tolerance, geos); }
+};
+
+/**
+ * Kernel functions picked once per rule from the geometry types of its layers
+ */
+class PairKernel
+{
+public:
+  typedef bool (*IntersectsFunction)(QgsGeometry*, QgsGeometry*, GeosContext*);
+  typedef bool (*DistanceFunction)(QgsGeometry*, QgsGeometry*, double, GeosContext*);
+
+  /**
+   * Constructor
+   * @param type1 geometry type of the first layer
+   * @param type2 geometry type of the second layer
+   */
+  PairKernel(QGis::GeometryType type1, QGis::GeometryType type2)
+  {
+    use<QGis::UnknownGeometry, QGis::UnknownGeometry>();
+
+    switch (type1)
+    {
+      case QGis::Point:
+        pick<QGis::Point>(type2);
+      break;
+
+      case QGis::Line:
+        pick<QGis::Line>(type2);
+      break;
+
+      case QGis::Polygon:
+        pick<QGis::Polygon>(type2);
+      break;
+
+      default:
+      break;
+    }
+  }
+
+  /**
+   * Checks whether the geometries intersect or touch
+   * @param geos GEOS context of the calling thread
+   */
+  bool intersects(QgsGeometry* g1, QgsGeometry* g2, GeosContext* geos) const { return mIntersects(g1, g2, geos); }
+  /**
+   * Checks whether the geometries are closer than the tolerance
+   * @param geos GEOS context of the calling thread
+   */
+  bool withinDistance(QgsGeometry* g1, QgsGeometry* g2, double tolerance, GeosContext* geos) const
+  {
+    return mWithinDistance(g1, g2, tolerance, geos);
+  }
+
+private:
+  IntersectsFunction mIntersects;
+  DistanceFunction mWithinDistance;
+
+  template <QGis::GeometryType Type1, QGis::GeometryType Type2>
+  void use()
+  {
+    mIntersects = &GeometryKernel<Type1, Type2>::intersects;
+    mWithinDistance = &GeometryKernel<Type1, Type2>::withinDistance;
+  }
+
+  template <QGis::GeometryType Type1>
+  void pick(QGis::GeometryType type2)
+  {
+    switch (type2)
+    {
+      case QGis::Point:
+        use<Type1, QGis::Point>();
+      break;
+
+      case QGis::Line:
+        use<Type1, QGis::Line>();
+      break;
+
+      case QGis::Polygon:
+        use<Type1, QGis::Polygon>();
+      break;
+
+      default:
+      break;
+    }
+  }
+};
+
+#endif
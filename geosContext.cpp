@@ -0,0 +1,234 @@
+/***************************************************************************
+  geosContext.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#include "geosContext.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// notices are not reported
+static void geosNotice(const char*, ...)
+{
+}
+
+static void geosError(const char* fmt, ...)
+{
+  char message[512];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+
+  std::cout << "GEOS error: " << message << "\n" << std::flush;
+}
+
+GeosContext::GeosContext()
+{
+  mHandle = initGEOS_r(geosNotice, geosError);
+}
+
+GeosContext::~GeosContext()
+{
+  clear();
+  finishGEOS_r(mHandle);
+}
+
+void GeosContext::clear()
+{
+  QHash<int, GEOSGeometry*>::Iterator it = mGeometries.begin();
+  for (; it != mGeometries.end(); ++it)
+    destroy(*it);
+  mGeometries.clear();
+}
+
+const GEOSGeometry* GeosContext::geometry(int key, QgsGeometry* g)
+{
+  QHash<int, GEOSGeometry*>::Iterator it = mGeometries.find(key);
+  if (it != mGeometries.end())
+    return *it;
+
+  GEOSGeometry* geos = exportGeometry(g);
+  mGeometries.insert(key, geos);
+  return geos;
+}
+
+GEOSGeometry* GeosContext::exportGeometry(QgsGeometry* g) const
+{
+  // the WKB is read by the reentrant reader, the global GEOS API is not touched
+  if (!g || !g->asWkb())
+    return 0;
+
+  return GEOSGeomFromWKB_buf_r(mHandle, g->asWkb(), g->wkbSize());
+}
+
+QgsGeometry* GeosContext::toGeometry(const GEOSGeometry* g) const
+{
+  size_t size = 0;
+  unsigned char* wkb = g ? GEOSGeomToWKB_buf_r(mHandle, g, &size) : 0;
+  if (!wkb)
+    return 0;
+
+  // QgsGeometry takes the WKB without touching the global GEOS API
+  unsigned char* copy = new unsigned char[size];
+  memcpy(copy, wkb, size);
+  GEOSFree_r(mHandle, wkb);
+
+  QgsGeometry* geometry = new QgsGeometry();
+  geometry->fromWkb(copy, size);
+  return geometry;
+}
+
+bool GeosContext::isValid(const GEOSGeometry* g) const
+{
+  // 2 reports an exception
+  return GEOSisValid_r(mHandle, g) != 0;
+}
+
+bool GeosContext::intersects(QgsGeometry* g1, QgsGeometry* g2) const
+{
+  GEOSGeometry* geos1 = exportGeometry(g1);
+  GEOSGeometry* geos2 = exportGeometry(g2);
+
+  bool result = geos1 && geos2 && GEOSIntersects_r(mHandle, geos1, geos2) == 1;
+
+  destroy(geos1);
+  destroy(geos2);
+  return result;
+}
+
+double GeosContext::distance(QgsGeometry* g1, QgsGeometry* g2) const
+{
+  GEOSGeometry* geos1 = exportGeometry(g1);
+  GEOSGeometry* geos2 = exportGeometry(g2);
+
+  double result = -1;
+  if (geos1 && geos2 && !GEOSDistance_r(mHandle, geos1, geos2, &result))
+    result = -1;
+
+  destroy(geos1);
+  destroy(geos2);
+  return result;
+}
+
+QgsGeometry* GeosContext::intersection(QgsGeometry* g1, QgsGeometry* g2) const
+{
+  GEOSGeometry* geos1 = exportGeometry(g1);
+  GEOSGeometry* geos2 = exportGeometry(g2);
+
+  GEOSGeometry* result = geos1 && geos2 ? GEOSIntersection_r(mHandle, geos1, geos2) : 0;
+  QgsGeometry* geometry = toGeometry(result);
+
+  destroy(result);
+  destroy(geos1);
+  destroy(geos2);
+  return geometry;
+}
+
+bool GeosContext::overlaps(const GEOSGeometry* g1, const GEOSGeometry* g2) const
+{
+  return GEOSOverlaps_r(mHandle, g1, g2) == 1;
+}
+
+bool GeosContext::contains(const GEOSGeometry* g1, const GEOSGeometry* g2) const
+{
+  return GEOSContains_r(mHandle, g1, g2) == 1;
+}
+
+GEOSGeometry* GeosContext::rectangle(const QgsRectangle& rect) const
+{
+  // polygon WKB in the native byte order, one ring of five points
+  int one = 1;
+  unsigned char wkb[1 + 3 * 4 + 10 * sizeof(double)];
+  unsigned char* p = wkb;
+  *p++ = *(char*) &one ? 1 : 0;
+
+  unsigned int header[3] = { 3, 1, 5 };
+  memcpy(p, header, sizeof(header));
+  p += sizeof(header);
+
+  double ring[10] = { rect.xMinimum(), rect.yMinimum(), rect.xMaximum(), rect.yMinimum(),
+                      rect.xMaximum(), rect.yMaximum(), rect.xMinimum(), rect.yMaximum(),
+                      rect.xMinimum(), rect.yMinimum() };
+  memcpy(p, ring, sizeof(ring));
+
+  return GEOSGeomFromWKB_buf_r(mHandle, wkb, sizeof(wkb));
+}
+
+GEOSGeometry* GeosContext::cascadedUnion(const QList<const GEOSGeometry*>& geometries) const
+{
+  QList<GEOSGeometry*> level;
+  for (int i = 0; i < geometries.size(); ++i)
+    level << GEOSGeom_clone_r(mHandle, geometries[i]);
+
+  while (level.size() > 1)
+  {
+    QList<GEOSGeometry*> next;
+    for (int i = 0; i < level.size(); i += 2)
+    {
+      if (i + 1 == level.size())
+      {
+        next << level[i];
+        continue;
+      }
+
+      GEOSGeometry* u = GEOSUnion_r(mHandle, level[i], level[i + 1]);
+      if (u)
+      {
+        GEOSGeom_destroy_r(mHandle, level[i]);
+        next << u;
+      }
+      else
+      {
+        std::cout << "Union failed, geometry skipped\n" << std::flush;
+        next << level[i];
+      }
+      GEOSGeom_destroy_r(mHandle, level[i + 1]);
+    }
+    level = next;
+  }
+
+  return level.isEmpty() ? 0 : level[0];
+}
+
+GEOSGeometry* GeosContext::difference(const GEOSGeometry* g1, const GEOSGeometry* g2) const
+{
+  return GEOSDifference_r(mHandle, g1, g2);
+}
+
+void GeosContext::destroy(GEOSGeometry* g) const
+{
+  if (g)
+    GEOSGeom_destroy_r(mHandle, g);
+}
+
+void GeosContext::polygonParts(const GEOSGeometry* g, QList<QgsGeometry*>& parts) const
+{
+  int type = GEOSGeomTypeId_r(mHandle, g);
+  if (type != GEOS_POLYGON && type != GEOS_MULTIPOLYGON)
+    return;
+
+  int count = GEOSGetNumGeometries_r(mHandle, g);
+  for (int i = 0; i < count; ++i)
+  {
+    QgsGeometry* geometry = toGeometry(GEOSGetGeometryN_r(mHandle, g, i));
+    if (geometry)
+      parts << geometry;
+  }
+}
@@ -0,0 +1,139 @@
+/***************************************************************************
+  geosContext.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#ifndef GEOSCONTEXT_H
+#define GEOSCONTEXT_H
+
+#include <QHash>
+#include <QList>
+
+#include <geos_c.h>
+
+#include <qgsgeometry.h>
+
+/**
+ * GEOS context of one thread using the reentrant GEOS API.
+ * QgsGeometry calls the global GEOS API, which is not thread-safe, so
+ * tests and their workers never call asGeos() or GEOS based QgsGeometry
+ * methods. They export the geometries from WKB with their own handle
+ * instead, and no GEOS object is shared with other threads. The context
+ * is used by one thread at a time.
+ */
+class GeosContext
+{
+public:
+  /**
+   * Constructor, initializes the GEOS handle
+   */
+  GeosContext();
+  /**
+   * Destroys the exported geometries and finishes the handle
+   */
+  ~GeosContext();
+
+  GEOSContextHandle_t handle() const { return mHandle; }
+
+  /**
+   * Returns GEOS geometry of the feature, exported on first use and
+   * owned by the context. Returns 0 if it cannot be exported.
+   * @param key feature key, unique within the context
+   * @param g geometry of the feature
+   */
+  const GEOSGeometry* geometry(int key, QgsGeometry* g);
+  /**
+   * Destroys the geometries exported by geometry(), so that the keys may be reused
+   */
+  void clear();
+  /**
+   * Returns GEOS geometry read from the WKB of the geometry,
+   * destroyed by the caller; 0 if it cannot be exported
+   */
+  GEOSGeometry* exportGeometry(QgsGeometry* g) const;
+  /**
+   * Returns new geometry built from WKB of the GEOS geometry, owned by the caller;
+   * 0 if it cannot be converted
+   */
+  QgsGeometry* toGeometry(const GEOSGeometry* g) const;
+
+  /**
+   * Checks whether the geometry is valid, a failed check counts as valid
+   */
+  bool isValid(const GEOSGeometry* g) const;
+
+  /**
+   * Checks whether the geometries overlap
+   */
+  bool overlaps(const GEOSGeometry* g1, const GEOSGeometry* g2) const;
+  /**
+   * Checks whether the first geometry contains the second one
+   */
+  bool contains(const GEOSGeometry* g1, const GEOSGeometry* g2) const;
+
+  /**
+   * Checks whether the geometries intersect, they are exported just for the test
+   */
+  bool intersects(QgsGeometry* g1, QgsGeometry* g2) const;
+  /**
+   * Returns distance of the geometries, they are exported just for the test;
+   * -1 if it cannot be computed
+   */
+  double distance(QgsGeometry* g1, QgsGeometry* g2) const;
+  /**
+   * Returns intersection of the geometries owned by the caller,
+   * 0 if it cannot be computed
+   */
+  QgsGeometry* intersection(QgsGeometry* g1, QgsGeometry* g2) const;
+
+  /**
+   * Returns new polygon of the rectangle, destroyed by the caller
+   * @param rect rectangle
+   */
+  GEOSGeometry* rectangle(const QgsRectangle& rect) const;
+  /**
+   * Returns union of the geometries computed pairwise in levels,
+   * destroyed by the caller. Returns 0 for an empty list.
+   * @param geometries geometries to be united
+   */
+  GEOSGeometry* cascadedUnion(const QList<const GEOSGeometry*>& geometries) const;
+  /**
+   * Returns the part of the first geometry not covered by the second one,
+   * destroyed by the caller
+   */
+  GEOSGeometry* difference(const GEOSGeometry* g1, const GEOSGeometry* g2) const;
+  /**
+   * Destroys a geometry returned by the context
+   */
+  void destroy(GEOSGeometry* g) const;
+
+  /**
+   * Appends polygons of the geometry as new geometries built from WKB,
+   * other geometry types add nothing
+   * @param g geometry
+   * @param parts list to be filled, the geometries are owned by the caller
+   */
+  void polygonParts(const GEOSGeometry* g, QList<QgsGeometry*>& parts) const;
+
+private:
+  GEOSContextHandle_t mHandle;
+  QHash<int, GEOSGeometry*> mGeometries;
+
+  GeosContext(const GeosContext&);
+  GeosContext& operator=(const GeosContext&);
+};
+
+#endif
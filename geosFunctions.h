@@ -62,6 +62,8 @@ bool geosTouches(QgsGeometry* g1, QgsGeometry* g2)
   {
     return false;
   }
+
+  return false;
 }
 
 /**
@@ -80,6 +82,8 @@ bool geosOverlaps(QgsGeometry* g1, QgsGeometry* g2)
   {
     return false;
   }
+
+  return false;
 }
 
 /**
@@ -98,6 +102,8 @@ bool geosContains(QgsGeometry* g1, QgsGeometry* g2)
   {
     return false;
   }
+
+  return false;
 }
 
 #endif
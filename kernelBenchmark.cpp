@@ -0,0 +1,205 @@
+/***************************************************************************
+  kernelBenchmark.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Compares the kernels specialized for geometry type pairs with the generic
+ * GEOS kernel on random features, standalone and without a QGIS project.
+ *
+ * Usage: topolKernelBenchmark [features] [vertices]
+ */
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QTime>
+#include <QVector>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include <qgsgeometry.h>
+
+#include "geometryKernels.h"
+
+static double randomValue()
+{
+  return (double) qrand() / RAND_MAX;
+}
+
+/**
+ * Returns random feature of the type with about the given number of vertices,
+ * features of the same type overlap each other often in the unit square
+ * @param type geometry type
+ * @param vertices vertex count of lines and polygons
+ */
+static QgsGeometry* randomGeometry(QGis::GeometryType type, int vertices)
+{
+  QgsPoint center(randomValue(), randomValue());
+  double radius = 0.01 + 0.04 * randomValue();
+
+  switch (type)
+  {
+    case QGis::Point:
+      return QgsGeometry::fromPoint(center);
+
+    case QGis::Line:
+    {
+      QgsPolyline line;
+      QgsPoint p = center;
+      for (int i = 0; i < vertices; ++i)
+      {
+        line << p;
+        p = QgsPoint(p.x() + radius * (randomValue() - 0.5), p.y() + radius * (randomValue() - 0.5));
+      }
+      return QgsGeometry::fromPolyline(line);
+    }
+
+    case QGis::Polygon:
+    {
+      // star shaped ring around the center, never self-intersecting
+      QgsPolyline ring;
+      for (int i = 0; i < vertices; ++i)
+      {
+        double angle = 2 * M_PI * i / vertices;
+        double r = radius * (0.5 + 0.5 * randomValue());
+        ring << QgsPoint(center.x() + r * cos(angle), center.y() + r * sin(angle));
+      }
+      ring << ring.first();
+
+      QgsPolygon polygon;
+      polygon << ring;
+      return QgsGeometry::fromPolygon(polygon);
+    }
+
+    default:
+      return 0;
+  }
+}
+
+static const char* typeName(QGis::GeometryType type)
+{
+  switch (type)
+  {
+    case QGis::Point:
+      return "point";
+    case QGis::Line:
+      return "line";
+    case QGis::Polygon:
+      return "polygon";
+    default:
+      return "unknown";
+  }
+}
+
+/**
+ * Times the predicate of the kernel over the pairs, returns the elapsed milliseconds
+ * @param kernel kernel to be timed
+ * @param distance true for withinDistance, false for intersects
+ * @param pairs geometry pairs
+ * @param tolerance distance of withinDistance
+ * @param results results of the pairs, filled
+ */
+static int timeKernel(const PairKernel& kernel, bool distance, const QList<QPair<QgsGeometry*, QgsGeometry*> >& pairs,
+                      double tolerance, QVector<bool>& results)
+{
+  results.resize(pairs.size());
+  GeosContext geos;
+
+  QTime timer;
+  timer.start();
+  for (int p = 0; p < pairs.size(); ++p)
+    results[p] = distance ? kernel.withinDistance(pairs[p].first, pairs[p].second, tolerance, &geos)
+                          : kernel.intersects(pairs[p].first, pairs[p].second, &geos);
+
+  return timer.elapsed();
+}
+
+int main(int argc, char** argv)
+{
+  int featureCount = argc > 1 ? atoi(argv[1]) : 2000;
+  int vertexCount = argc > 2 ? atoi(argv[2]) : 32;
+  double tolerance = 0.005;
+
+  if (featureCount <= 0 || vertexCount < 3)
+  {
+    std::cout << "Usage: " << argv[0] << " [features] [vertices]\n";
+    return 1;
+  }
+
+  qsrand(1);
+
+  QGis::GeometryType types[] = { QGis::Point, QGis::Line, QGis::Polygon };
+  QList<QgsGeometry*> geometries[3];
+  for (int t = 0; t < 3; ++t)
+    for (int i = 0; i < featureCount; ++i)
+    {
+      // the GEOS export of the generic kernel is timed, the rules export in their contexts too
+      geometries[t] << randomGeometry(types[t], vertexCount);
+    }
+
+  PairKernel generic(QGis::UnknownGeometry, QGis::UnknownGeometry);
+
+  std::cout << featureCount << " features per type, " << vertexCount << " vertices, tolerance " << tolerance << "\n";
+  std::cout << "pair               predicate        pairs  specialized ms  generic ms  mismatches\n";
+
+  for (int t1 = 0; t1 < 3; ++t1)
+    for (int t2 = 0; t2 < 3; ++t2)
+    {
+      // the rules test only pairs of index candidates, boxes closer than the tolerance
+      QList<QPair<QgsGeometry*, QgsGeometry*> > pairs;
+      for (int i = 0; i < geometries[t1].size(); ++i)
+      {
+        QgsRectangle bb1 = geometries[t1][i]->boundingBox();
+        for (int j = 0; j < geometries[t2].size(); ++j)
+        {
+          QgsRectangle bb2 = geometries[t2][j]->boundingBox();
+          if (bb2.xMinimum() <= bb1.xMaximum() + tolerance && bb1.xMinimum() <= bb2.xMaximum() + tolerance &&
+              bb2.yMinimum() <= bb1.yMaximum() + tolerance && bb1.yMinimum() <= bb2.yMaximum() + tolerance)
+            pairs << qMakePair(geometries[t1][i], geometries[t2][j]);
+        }
+      }
+
+      PairKernel specialized(types[t1], types[t2]);
+      for (int d = 0; d < 2; ++d)
+      {
+        QVector<bool> specializedResults, genericResults;
+        int specializedTime = timeKernel(specialized, d, pairs, tolerance, specializedResults);
+        int genericTime = timeKernel(generic, d, pairs, tolerance, genericResults);
+
+        int mismatches = 0;
+        for (int p = 0; p < pairs.size(); ++p)
+          if (specializedResults[p] != genericResults[p])
+            ++mismatches;
+
+        QString pair = QString("%1/%2").arg(typeName(types[t1])).arg(typeName(types[t2]));
+        std::cout << pair.leftJustified(18).toStdString() << " "
+                  << QString(d ? "withinDistance" : "intersects").leftJustified(14).toStdString()
+                  << QString::number(pairs.size()).rightJustified(9).toStdString()
+                  << QString::number(specializedTime).rightJustified(16).toStdString()
+                  << QString::number(genericTime).rightJustified(12).toStdString()
+                  << QString::number(mismatches).rightJustified(12).toStdString() << "\n";
+      }
+    }
+
+  std::cout << std::flush;
+
+  for (int t = 0; t < 3; ++t)
+    qDeleteAll(geometries[t]);
+
+  return 0;
+}
@@ -0,0 +1,282 @@
+/***************************************************************************
+  layerCache.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "layerCache.h"
+
+#include <QMutexLocker>
+#include <QTime>
+
+#include "featureQueue.h"
+#include "testRun.h"
+
+LayerData::LayerData()
+{
+  index = 0;
+  order = OrderNone;
+  mRefs = 0;
+  mDropped = false;
+}
+
+LayerData::~LayerData()
+{
+  delete index;
+
+  QMap<double, PlanarGraph*>::Iterator it = mGraphs.begin();
+  for (; it != mGraphs.end(); ++it)
+    delete *it;
+}
+
+PlanarGraph* LayerData::graph(double tolerance)
+{
+  QMutexLocker locker(&mGraphMutex);
+
+  PlanarGraph* graph = mGraphs.value(tolerance);
+  if (!graph)
+  {
+    // the graph refers to features by their positions in the store
+    graph = new PlanarGraph(tolerance);
+    graph->build(features, index);
+    mGraphs[tolerance] = graph;
+  }
+
+  return graph;
+}
+
+LayerCache::~LayerCache()
+{
+  QMap<QString, LayerData*>::Iterator it = mLayers.begin();
+  for (; it != mLayers.end(); ++it)
+    delete *it;
+
+  QMap<QString, QMutex*>::Iterator mit = mProviderMutexes.begin();
+  for (; mit != mProviderMutexes.end(); ++mit)
+    delete *mit;
+}
+
+QMutex* LayerCache::providerMutex(const QString& layerId)
+{
+  QMutexLocker locker(&mMutex);
+
+  QMutex* mutex = mProviderMutexes.value(layerId);
+  if (!mutex)
+  {
+    mutex = new QMutex;
+    mProviderMutexes[layerId] = mutex;
+  }
+
+  return mutex;
+}
+
+QString LayerCache::cacheKey(QgsVectorLayer* layer, const QgsCoordinateReferenceSystem& crs)
+{
+  if (!crs.isValid() || crs == layer->srs())
+    return layer->getLayerID();
+
+  return layer->getLayerID() + "@" + QString::number(crs.srsid());
+}
+
+LayerData* LayerCache::cached(const QString& key, TestRun* run)
+{
+  QMutexLocker locker(&mMutex);
+
+  LayerData* data = mLayers.value(key);
+  if (!data)
+    return 0;
+
+  // rebuild when the run asks for another backend or ordering than the cached one
+  IndexType type = run->indexType();
+  if ((type != IndexAuto && data->index->type() != type) || data->order != run->spatialOrder())
+    return 0;
+
+  ++data->mRefs;
+  return data;
+}
+
+bool LayerCache::isCached(QgsVectorLayer* layer, TestRun* run)
+{
+  LayerData* data = cached(cacheKey(layer, run->workingCrs()), run);
+  if (data)
+    release(data);
+  return data;
+}
+
+LayerData* LayerCache::acquire(QgsVectorLayer* layer, TestRun* run, FeatureQueue* read)
+{
+  QString key = cacheKey(layer, run->workingCrs());
+  LayerData* data = cached(key, run);
+  if (data)
+    return data;
+
+  // another run may have loaded the layer while this one waited for the provider
+  QMutexLocker providerLocker(providerMutex(layer->getLayerID()));
+  data = cached(key, run);
+  if (data)
+    return data;
+
+  data = load(layer, run, read);
+  if (!data)
+    return 0;
+
+  QMutexLocker locker(&mMutex);
+  if (mLayers.contains(key))
+    dropData(mLayers[key]);
+
+  data->mRefs = 1;
+  mLayers[key] = data;
+  return data;
+}
+
+void LayerCache::release(LayerData* data)
+{
+  QMutexLocker locker(&mMutex);
+  if (!--data->mRefs && data->mDropped)
+    delete data;
+}
+
+void LayerCache::drop(const QString& layerId)
+{
+  QMutexLocker locker(&mMutex);
+
+  QList<LayerData*> dropped;
+  QMap<QString, LayerData*>::ConstIterator it = mLayers.begin();
+  for (; it != mLayers.end(); ++it)
+    if (it.key() == layerId || it.key().startsWith(layerId + "@"))
+      dropped << *it;
+
+  for (int i = 0; i < dropped.size(); ++i)
+    dropData(dropped[i]);
+}
+
+void LayerCache::dropData(LayerData* data)
+{
+  QMap<QString, LayerData*>::Iterator it = mLayers.begin();
+  for (; it != mLayers.end(); ++it)
+    if (*it == data)
+    {
+      mLayers.erase(it);
+      break;
+    }
+
+  data->mDropped = true;
+  if (!data->mRefs)
+    delete data;
+}
+
+LayerData* LayerCache::load(QgsVectorLayer* layer, TestRun* run, FeatureQueue* read)
+{
+  LayerStatistics stats(layer->geometryType());
+  FeatureStore features;
+  features.reserve(layer->featureCount());
+
+  // the provider is read in another thread while the batches read so far are processed
+  FeatureQueue queue;
+  FeatureReader reader(layer, QgsRectangle(), &queue);
+  if (!read)
+  {
+    reader.setDestinationCrs(run->workingCrs());
+    reader.start();
+    read = &queue;
+  }
+
+  int i = 0;
+  QgsFeatureList batch;
+  while (read->pop(batch))
+  {
+    for (int b = 0; b < batch.size(); ++b)
+    {
+      if (!(++i % 100))
+        run->setProgress(i);
+
+      QgsGeometry* g = batch[b].geometry();
+      if (!g)
+        continue;
+
+      stats.addFeature(g->boundingBox());
+      features.add(FeatureLayer(layer, batch[b]));
+    }
+
+    if (run->isCancelled())
+    {
+      read->close();
+      reader.wait();
+      return 0;
+    }
+  }
+  reader.wait();
+
+  // arrange the store along the curve before the index refers to its positions
+  QTime orderTimer;
+  orderTimer.start();
+  LayerData* data = new LayerData;
+  data->features = sortFeatures(features, run->spatialOrder());
+  data->order = run->spatialOrder();
+  run->addOrderTime(orderTimer.elapsed());
+
+  // bulk load the backend once all bounding boxes are known,
+  // entries are the compact indexes into the feature store
+  TopolIndex* index = TopolIndex::create(run->indexType(), stats);
+  for (int j = 0; j < data->features.size(); ++j)
+  {
+    QgsGeometry* g = data->features[j].feature.geometry();
+    QgsRectangle bb = g->boundingBox();
+
+    // a geometry spanning many average features would be a candidate of all of them,
+    // it is indexed by its parts or vertex runs instead
+    if (bb.width() > 16 * stats.meanWidth() || bb.height() > 16 * stats.meanHeight())
+      index->insertParts(j, g);
+    else
+      index->insert(j, bb);
+  }
+  index->build();
+  data->index = index;
+
+  return data;
+}
+
+CacheWarmUp::CacheWarmUp(LayerCache* cache, const QList<TestRun*>& runs, const QList<FeatureQueue*>& features)
+{
+  mCache = cache;
+  mRuns = runs;
+  mFeatures = features;
+}
+
+CacheWarmUp::~CacheWarmUp()
+{
+  qDeleteAll(mRuns);
+  qDeleteAll(mFeatures);
+}
+
+void CacheWarmUp::cancel()
+{
+  for (int i = 0; i < mRuns.size(); ++i)
+    mRuns[i]->cancel();
+}
+
+void CacheWarmUp::run()
+{
+  for (int i = 0; i < mRuns.size() && !mRuns[i]->isCancelled(); ++i)
+  {
+    // the cache keeps the data once released
+    LayerData* data = mCache->acquire(mRuns[i]->layer1(), mRuns[i], mFeatures[i]);
+    if (data)
+      mCache->release(data);
+
+    // the read features are in the store now
+    delete mFeatures[i];
+    mFeatures[i] = 0;
+  }
+}
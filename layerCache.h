@@ -0,0 +1,183 @@
+/***************************************************************************
+  layerCache.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef LAYERCACHE_H
+#define LAYERCACHE_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+#include <qgsvectorlayer.h>
+
+#include "featureStore.h"
+#include "spatialOrder.h"
+#include "topolGraph.h"
+#include "topolIndex.h"
+
+class FeatureQueue;
+class TestRun;
+
+/**
+ * Features of a layer with their spatial index and planar graphs,
+ * shared by all runs checking the layer. The features and the index
+ * are only read once loaded. The geometries are never exported by the
+ * global GEOS API, so that copying them from any thread is safe; the runs
+ * export them in their own GEOS contexts.
+ */
+class LayerData
+{
+public:
+  LayerData();
+  ~LayerData();
+
+  TopolIndex* index;
+  FeatureStore features;
+  SpatialOrder order;
+
+  /**
+   * Returns planar graph of the features, building it on first use
+   * @param tolerance snapping distance of the graph nodes
+   */
+  PlanarGraph* graph(double tolerance);
+
+private:
+  // graphs by their snapping tolerance
+  QMap<double, PlanarGraph*> mGraphs;
+  QMutex mGraphMutex;
+  // runs holding the data
+  int mRefs;
+  // no longer in the cache, deleted by the last release
+  bool mDropped;
+
+  friend class LayerCache;
+};
+
+/**
+ * Thread safe cache of layer data. Runs acquire the data they use and
+ * release them when they end; data of a modified layer are dropped from
+ * the cache at once, but deleted only after the last run releases them.
+ */
+class LayerCache
+{
+public:
+  ~LayerCache();
+
+  /**
+   * Returns data of the layer loaded with the index backend and ordering of the run,
+   * loading them when missing or built differently; null if the run was cancelled.
+   * Geometries are transformed into the working coordinate system of the run,
+   * the data are cached for every coordinate system they were transformed to.
+   * @param layer pointer to the layer
+   * @param run run the data are loaded for, reports the progress and gets the ordering time
+   * @param read features already read from the provider by the caller, transformed
+   *  into the working coordinate system; the provider is read when null
+   */
+  LayerData* acquire(QgsVectorLayer* layer, TestRun* run, FeatureQueue* read = 0);
+  /**
+   * Returns true if data of the layer suiting the run are cached
+   * @param layer pointer to the layer
+   * @param run run asking for the data
+   */
+  bool isCached(QgsVectorLayer* layer, TestRun* run);
+  /**
+   * Releases data acquired by a run
+   * @param data layer data
+   */
+  void release(LayerData* data);
+  /**
+   * Drops cached data of the layer in all coordinate systems
+   * @param layerId layer ID
+   */
+  void drop(const QString& layerId);
+  /**
+   * Returns mutex serializing reading of the layer's features, data providers
+   * are not thread safe, but different layers may be read at once
+   * @param layerId layer ID
+   */
+  QMutex* providerMutex(const QString& layerId);
+
+private:
+  // data by the layer ID, with the coordinate system ID appended if transformed
+  QMap<QString, LayerData*> mLayers;
+  QMap<QString, QMutex*> mProviderMutexes;
+  // guards the maps and the reference counts
+  QMutex mMutex;
+
+  /**
+   * Returns key of the layer data in the cache
+   * @param layer pointer to the layer
+   * @param crs coordinate system of the data
+   */
+  static QString cacheKey(QgsVectorLayer* layer, const QgsCoordinateReferenceSystem& crs);
+  /**
+   * Returns cached data of the layer if they suit the run, referenced for it
+   * @param key layer data key
+   * @param run run asking for the data
+   */
+  LayerData* cached(const QString& key, TestRun* run);
+  /**
+   * Loads features of the layer, sorts them and builds the index over them
+   * @param layer pointer to the layer
+   * @param run run the data are loaded for
+   * @param read features already read by the caller, null to read the provider
+   */
+  LayerData* load(QgsVectorLayer* layer, TestRun* run, FeatureQueue* read);
+  /**
+   * Removes the data from the cache, deletes them if no run holds them
+   * @param data layer data, must be guarded by mMutex
+   */
+  void dropData(LayerData* data);
+};
+
+/**
+ * Low priority thread loading layers into the cache ahead of the runs,
+ * a run asking for a layer being loaded waits for it and takes it then.
+ * The providers are read by the caller in the GUI thread, so that the
+ * thread never reads them while the map canvas renders; it only orders
+ * and indexes the features.
+ */
+class CacheWarmUp : public QThread
+{
+public:
+  /**
+   * Constructor
+   * @param cache layer cache to be filled
+   * @param runs runs whose first layers are loaded with their index backend and ordering,
+   * owned by the thread
+   * @param features features of the first layers read by the caller, one queue per run
+   *  owned by the thread
+   */
+  CacheWarmUp(LayerCache* cache, const QList<TestRun*>& runs, const QList<FeatureQueue*>& features);
+  ~CacheWarmUp();
+
+  /**
+   * Stops loading, the layer being loaded is dropped
+   */
+  void cancel();
+
+protected:
+  void run();
+
+private:
+  LayerCache* mCache;
+  QList<TestRun*> mRuns;
+  QList<FeatureQueue*> mFeatures;
+};
+
+#endif
@@ -0,0 +1,146 @@
+/***************************************************************************
+  lineNoder.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "lineNoder.h"
+
+#include <algorithm>
+
+#include "nativeFunctions.h"
+
+// orders segment indexes by the left edge of their bounding box
+class SegmentXMinLess
+{
+public:
+  SegmentXMinLess(const QVector<NodedSegment>& segments) : mSegments(segments) {}
+  bool operator()(int a, int b) const { return mSegments[a].xMin() < mSegments[b].xMin(); }
+
+private:
+  const QVector<NodedSegment>& mSegments;
+};
+
+LineNoder::LineNoder(bool groupMode)
+{
+  mGroupMode = groupMode;
+  mSkipSameOwner = false;
+}
+
+void LineNoder::addGeometry(QgsGeometry* g, int owner, int group)
+{
+  QList<QgsPolyline> parts;
+  linearParts(g, parts);
+
+  for (int k = 0; k < parts.size(); ++k)
+    addPolyline(parts[k], owner, group, k);
+}
+
+void LineNoder::addPolyline(const QgsPolyline& line, int owner, int group, int part)
+{
+  for (int i = 1; i < line.size(); ++i)
+  {
+    NodedSegment s;
+    s.p1 = line[i-1];
+    s.p2 = line[i];
+    s.owner = owner;
+    s.group = group;
+    s.part = part;
+    s.index = i - 1;
+    s.first = i == 1;
+    s.last = i == line.size() - 1;
+    mSegments << s;
+  }
+}
+
+bool LineNoder::isPartEndpoint(int segment, const QgsPoint& p) const
+{
+  const NodedSegment& s = mSegments[segment];
+  return (s.first && s.p1 == p) || (s.last && s.p2 == p);
+}
+
+void LineNoder::intersect(int s1, int s2, QList<SegmentIntersection>& result) const
+{
+  const NodedSegment& a = mSegments[s1];
+  const NodedSegment& b = mSegments[s2];
+
+  if (mSkipSameOwner && a.owner == b.owner)
+    return;
+
+  // consecutive segments of one part always share their common vertex
+  if (a.owner == b.owner && a.group == b.group && a.part == b.part && qAbs(a.index - b.index) == 1)
+    return;
+
+  if (a.yMax() < b.yMin() || b.yMax() < a.yMin())
+    return;
+
+  SegmentIntersection si;
+  int n = segmentIntersection(a.p1, a.p2, b.p1, b.p2, si.point, si.point2);
+  if (!n)
+    return;
+
+  si.overlap = n == 2;
+  if (a.group <= b.group)
+  {
+    si.segment1 = s1;
+    si.segment2 = s2;
+  }
+  else
+  {
+    si.segment1 = s2;
+    si.segment2 = s1;
+  }
+
+  result << si;
+}
+
+QList<SegmentIntersection> LineNoder::intersections() const
+{
+  QList<SegmentIntersection> result;
+
+  QVector<int> order(mSegments.size());
+  for (int i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), SegmentXMinLess(mSegments));
+
+  // segments whose x-interval may still reach the sweep line, one list per group in group mode
+  QVector<int> active[2];
+
+  for (int i = 0; i < order.size(); ++i)
+  {
+    int s = order[i];
+    const NodedSegment& seg = mSegments[s];
+    double x = seg.xMin();
+    int group = mGroupMode ? (seg.group ? 1 : 0) : 0;
+
+    QVector<int>& candidates = active[mGroupMode ? 1 - group : 0];
+    for (int j = 0; j < candidates.size(); )
+    {
+      // drop segments left behind by the sweep line
+      if (mSegments[candidates[j]].xMax() < x)
+      {
+        candidates[j] = candidates.last();
+        candidates.pop_back();
+        continue;
+      }
+
+      intersect(candidates[j], s, result);
+      ++j;
+    }
+
+    active[group] << s;
+  }
+
+  return result;
+}
@@ -0,0 +1,126 @@
+/***************************************************************************
+  lineNoder.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef LINENODER_H
+#define LINENODER_H
+
+#include <QList>
+#include <QVector>
+
+#include <qgsgeometry.h>
+#include <qgspoint.h>
+
+class NodedSegment
+{
+public:
+  QgsPoint p1;
+  QgsPoint p2;
+  // id of the feature the segment comes from
+  int owner;
+  // group of the feature, only segments from different groups are intersected in group mode
+  int group;
+  // part (or ring) of the feature
+  int part;
+  // position of the segment in the part
+  int index;
+  // true if p1 is the start point of the part
+  bool first;
+  // true if p2 is the end point of the part
+  bool last;
+
+  double xMin() const { return qMin(p1.x(), p2.x()); }
+  double xMax() const { return qMax(p1.x(), p2.x()); }
+  double yMin() const { return qMin(p1.y(), p2.y()); }
+  double yMax() const { return qMax(p1.y(), p2.y()); }
+};
+
+class SegmentIntersection
+{
+public:
+  // indexes into LineNoder::segments()
+  int segment1;
+  int segment2;
+  QgsPoint point;
+  // end of the shared part when the segments overlap
+  QgsPoint point2;
+  bool overlap;
+};
+
+/**
+ * Finds all intersections between segments of many geometries in one
+ * plane sweep instead of testing the geometries pairwise.
+ */
+class LineNoder
+{
+public:
+  /**
+   * Constructor
+   * @param groupMode intersect only segments coming from different groups
+   */
+  LineNoder(bool groupMode = false);
+
+  /**
+   * Adds all segments of lines, multilines and polygon rings of the geometry
+   * @param g geometry
+   * @param owner feature id stored with the segments
+   * @param group feature group
+   */
+  void addGeometry(QgsGeometry* g, int owner, int group = 0);
+  /**
+   * Adds all segments of the polyline
+   * @param line polyline
+   * @param owner feature id stored with the segments
+   * @param group feature group
+   * @param part part number stored with the segments
+   */
+  void addPolyline(const QgsPolyline& line, int owner, int group, int part);
+  /**
+   * Skip intersections of segments with the same owner
+   * @param skip true to skip
+   */
+  void setSkipSameOwner(bool skip) { mSkipSameOwner = skip; }
+  /**
+   * Returns all segments added so far
+   */
+  const QVector<NodedSegment>& segments() const { return mSegments; }
+  /**
+   * Runs the sweep and returns all segment intersections
+   * Segment with the lower group is always the first one of the pair.
+   */
+  QList<SegmentIntersection> intersections() const;
+  /**
+   * Checks whether the point is a start or end point of the segment's part
+   * @param segment segment index
+   * @param p tested point
+   */
+  bool isPartEndpoint(int segment, const QgsPoint& p) const;
+
+private:
+  QVector<NodedSegment> mSegments;
+  bool mGroupMode;
+  bool mSkipSameOwner;
+
+  /**
+   * Intersects two segments and appends the result to the list
+   * @param s1 first segment index
+   * @param s2 second segment index
+   * @param result list of intersections
+   */
+  void intersect(int s1, int s2, QList<SegmentIntersection>& result) const;
+};
+
+#endif
@@ -0,0 +1,441 @@
+/***************************************************************************
+  nativeFunctions.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef NATIVEFUNCTIONS_H
+#define NATIVEFUNCTIONS_H
+
+#include <cmath>
+#include <cstring>
+
+#include <qgsgeometry.h>
+#include <qgspoint.h>
+
+#include "robustPredicates.h"
+
+/*
+ * Geometry helpers working directly on QgsPoint coordinates,
+ * counterparts of the GEOS based routines in geosFunctions.h
+ */
+
+/**
+ * Returns twice the signed area of the triangle abc
+ * (positive when c lies to the left of the directed line ab)
+ * @param a first point
+ * @param b second point
+ * @param c tested point
+ */
+inline double orientation(const QgsPoint& a, const QgsPoint& b, const QgsPoint& c)
+{
+  return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+/**
+ * Checks whether the point collinear with segment ab lies within its bounding box
+ * @param a segment start
+ * @param b segment end
+ * @param p tested point
+ */
+inline bool withinSegmentBox(const QgsPoint& a, const QgsPoint& b, const QgsPoint& p)
+{
+  return qMin(a.x(), b.x()) <= p.x() && p.x() <= qMax(a.x(), b.x()) &&
+         qMin(a.y(), b.y()) <= p.y() && p.y() <= qMax(a.y(), b.y());
+}
+
+/**
+ * Returns squared distance of the point from segment ab
+ * @param p tested point
+ * @param a segment start
+ * @param b segment end
+ */
+inline double sqrDistToSegment(const QgsPoint& p, const QgsPoint& a, const QgsPoint& b)
+{
+  double dx = b.x() - a.x();
+  double dy = b.y() - a.y();
+  double length = dx * dx + dy * dy;
+  double t = length > 0 ? ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / length : 0;
+
+  if (t <= 0)
+    return p.sqrDist(a);
+  if (t >= 1)
+    return p.sqrDist(b);
+
+  return p.sqrDist(a.x() + t * dx, a.y() + t * dy);
+}
+
+/**
+ * Checks whether the point lies on the polyline, exactly
+ * or within the tolerance when it is given
+ * @param p tested point
+ * @param line polyline
+ * @param tolerance allowed distance, 0 for an exact test
+ */
+inline bool pointOnLine(const QgsPoint& p, const QgsPolyline& line, double tolerance)
+{
+  double sqrTolerance = tolerance * tolerance;
+  for (int i = 1; i < line.size(); ++i)
+  {
+    const QgsPoint& a = line[i-1];
+    const QgsPoint& b = line[i];
+
+    if (p.x() < qMin(a.x(), b.x()) - tolerance || p.x() > qMax(a.x(), b.x()) + tolerance ||
+        p.y() < qMin(a.y(), b.y()) - tolerance || p.y() > qMax(a.y(), b.y()) + tolerance)
+      continue;
+
+    if (tolerance > 0 ? sqrDistToSegment(p, a, b) <= sqrTolerance : orientationSign(a, b, p) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Intersects segments p1p2 and q1q2
+ * Returns 0 if the segments are disjoint, 1 if they meet in a single point
+ * (stored in i1) and 2 if they are collinear and overlap (overlap stored in i1, i2).
+ * Points lying on vertices are returned as exact copies of the vertices.
+ * @param p1 first segment start
+ * @param p2 first segment end
+ * @param q1 second segment start
+ * @param q2 second segment end
+ * @param i1 first intersection point
+ * @param i2 second intersection point of the collinear overlap
+ */
+inline int segmentIntersection(const QgsPoint& p1, const QgsPoint& p2, const QgsPoint& q1, const QgsPoint& q2, QgsPoint& i1, QgsPoint& i2)
+{
+  // the sides are decided exactly, so that nearly collinear segments are classified like GEOS does
+  int d1 = orientationSign(q1, q2, p1);
+  int d2 = orientationSign(q1, q2, p2);
+  int d3 = orientationSign(p1, p2, q1);
+  int d4 = orientationSign(p1, p2, q2);
+
+  if ((d1 && d1 == d2) || (d3 && d3 == d4))
+    return 0;
+
+  if (!d1 && !d2 && !d3 && !d4)
+  {
+    // collinear segments - compare along the dominant axis
+    bool alongX = qAbs(p2.x() - p1.x()) + qAbs(q2.x() - q1.x()) >= qAbs(p2.y() - p1.y()) + qAbs(q2.y() - q1.y());
+    QgsPoint pMin = p1, pMax = p2, qMin = q1, qMax = q2;
+    if (alongX ? pMin.x() > pMax.x() : pMin.y() > pMax.y())
+      qSwap(pMin, pMax);
+    if (alongX ? qMin.x() > qMax.x() : qMin.y() > qMax.y())
+      qSwap(qMin, qMax);
+
+    QgsPoint start = (alongX ? pMin.x() >= qMin.x() : pMin.y() >= qMin.y()) ? pMin : qMin;
+    QgsPoint end = (alongX ? pMax.x() <= qMax.x() : pMax.y() <= qMax.y()) ? pMax : qMax;
+    double s = alongX ? start.x() : start.y();
+    double e = alongX ? end.x() : end.y();
+
+    if (s > e)
+      return 0;
+
+    i1 = start;
+    if (s == e)
+      return 1;
+
+    i2 = end;
+    return 2;
+  }
+
+  // touching in a vertex
+  if (!d1 && withinSegmentBox(q1, q2, p1))
+  {
+    i1 = p1;
+    return 1;
+  }
+  if (!d2 && withinSegmentBox(q1, q2, p2))
+  {
+    i1 = p2;
+    return 1;
+  }
+  if (!d3 && withinSegmentBox(p1, p2, q1))
+  {
+    i1 = q1;
+    return 1;
+  }
+  if (!d4 && withinSegmentBox(p1, p2, q2))
+  {
+    i1 = q2;
+    return 1;
+  }
+
+  if (d1 * d2 >= 0 || d3 * d4 >= 0)
+    return 0;
+
+  // proper crossing
+  double a1 = orientation(q1, q2, p1);
+  double a2 = orientation(q1, q2, p2);
+  double t = a1 / (a1 - a2);
+  i1 = QgsPoint(p1.x() + t * (p2.x() - p1.x()), p1.y() + t * (p2.y() - p1.y()));
+  return 1;
+}
+
+/**
+ * Returns squared distance of segments ab and cd, 0 if they intersect
+ * @param a first segment start
+ * @param b first segment end
+ * @param c second segment start
+ * @param d second segment end
+ */
+inline double sqrSegmentDistance(const QgsPoint& a, const QgsPoint& b, const QgsPoint& c, const QgsPoint& d)
+{
+  QgsPoint i1, i2;
+  if (segmentIntersection(a, b, c, d, i1, i2))
+    return 0;
+
+  return qMin(qMin(sqrDistToSegment(a, c, d), sqrDistToSegment(b, c, d)),
+              qMin(sqrDistToSegment(c, a, b), sqrDistToSegment(d, a, b)));
+}
+
+/**
+ * Returns points of the point or multipoint
+ * @param g point geometry
+ */
+inline QgsMultiPoint pointParts(QgsGeometry* g)
+{
+  if (g->wkbType() == QGis::WKBMultiPoint || g->wkbType() == QGis::WKBMultiPoint25D)
+    return g->asMultiPoint();
+
+  QgsMultiPoint points;
+  points << g->asPoint();
+  return points;
+}
+
+/**
+ * Appends linear components of the geometry to the list:
+ * lines and parts of multilines as they are, polygon rings as closed polylines
+ * @param g geometry
+ * @param parts list to be filled
+ */
+inline void linearParts(QgsGeometry* g, QList<QgsPolyline>& parts)
+{
+  QgsPolygon pol;
+  QgsMultiPolyline mls;
+  QgsMultiPolygon mpol;
+
+  switch (g->wkbType())
+  {
+    case QGis::WKBLineString:
+    case QGis::WKBLineString25D:
+      parts << g->asPolyline();
+    break;
+
+    case QGis::WKBMultiLineString:
+    case QGis::WKBMultiLineString25D:
+      mls = g->asMultiPolyline();
+      for (int i = 0; i < mls.size(); ++i)
+        parts << mls[i];
+    break;
+
+    case QGis::WKBPolygon:
+    case QGis::WKBPolygon25D:
+      pol = g->asPolygon();
+      for (int i = 0; i < pol.size(); ++i)
+        parts << pol[i];
+    break;
+
+    case QGis::WKBMultiPolygon:
+    case QGis::WKBMultiPolygon25D:
+      mpol = g->asMultiPolygon();
+      for (int k = 0; k < mpol.size(); ++k)
+        for (int i = 0; i < mpol[k].size(); ++i)
+          parts << mpol[k][i];
+    break;
+
+    default:
+    break;
+  }
+}
+
+/**
+ * Returns number of vertices of the geometry, used to estimate the cost of tests
+ * @param g geometry
+ */
+inline int vertexCount(QgsGeometry* g)
+{
+  switch (g->wkbType())
+  {
+    case QGis::WKBPoint:
+    case QGis::WKBPoint25D:
+      return 1;
+
+    case QGis::WKBMultiPoint:
+    case QGis::WKBMultiPoint25D:
+      return g->asMultiPoint().size();
+
+    default:
+    break;
+  }
+
+  QList<QgsPolyline> parts;
+  linearParts(g, parts);
+
+  int count = 0;
+  for (int i = 0; i < parts.size(); ++i)
+    count += parts[i].size();
+  return count;
+}
+
+/**
+ * Returns twice the signed area of the ring, positive for counter-clockwise rings
+ * @param ring closed polyline
+ */
+inline double ringArea(const QgsPolyline& ring)
+{
+  double area = 0;
+  for (int i = 1; i < ring.size(); ++i)
+    area += ring[i-1].x() * ring[i].y() - ring[i].x() * ring[i-1].y();
+  return area;
+}
+
+/**
+ * Returns length of the polyline
+ * @param line polyline
+ */
+inline double lineLength(const QgsPolyline& line)
+{
+  double length = 0;
+  for (int i = 1; i < line.size(); ++i)
+    length += sqrt(line[i-1].sqrDist(line[i]));
+  return length;
+}
+
+/**
+ * Checks whether the point lies inside the ring (even-odd rule)
+ * @param p tested point
+ * @param ring closed polyline
+ */
+inline bool pointInRing(const QgsPoint& p, const QgsPolyline& ring)
+{
+  bool inside = false;
+  for (int i = 1; i < ring.size(); ++i)
+  {
+    const QgsPoint& a = ring[i-1];
+    const QgsPoint& b = ring[i];
+    // the point lies left of an upward edge or right of a downward one
+    if ((a.y() > p.y()) != (b.y() > p.y()) &&
+        (b.y() > a.y() ? orientationSign(a, b, p) > 0 : orientationSign(a, b, p) < 0))
+      inside = !inside;
+  }
+  return inside;
+}
+
+/**
+ * Checks whether the point lies inside the polygon or multipolygon,
+ * counting crossings of all rings, so holes are excluded
+ * @param p tested point
+ * @param g polygon geometry
+ */
+inline bool pointInPolygon(const QgsPoint& p, QgsGeometry* g)
+{
+  QList<QgsPolyline> rings;
+  linearParts(g, rings);
+
+  bool inside = false;
+  for (int i = 0; i < rings.size(); ++i)
+    if (pointInRing(p, rings[i]))
+      inside = !inside;
+  return inside;
+}
+
+/*
+ * Geometries built from WKB in the native byte order. QgsGeometry::fromPoint and
+ * the other factories go through the global GEOS API, which is not thread-safe,
+ * so the tests running in several threads build their conflict geometries here.
+ */
+
+/**
+ * Writes the value into the WKB buffer, returns position after it
+ */
+template <class T>
+inline unsigned char* wkbWrite(unsigned char* p, T value)
+{
+  memcpy(p, &value, sizeof(T));
+  return p + sizeof(T);
+}
+
+/**
+ * Writes byte order and type of a WKB geometry, returns position after them
+ */
+inline unsigned char* wkbHeader(unsigned char* p, QGis::WkbType type)
+{
+  int one = 1;
+  *p++ = *(char*) &one ? 1 : 0;
+  return wkbWrite(p, (unsigned int) type);
+}
+
+/**
+ * Returns new geometry taking ownership of the WKB buffer
+ */
+inline QgsGeometry* wkbGeometry(unsigned char* wkb, size_t size)
+{
+  QgsGeometry* g = new QgsGeometry();
+  g->fromWkb(wkb, size);
+  return g;
+}
+
+/**
+ * Returns new point geometry
+ * @param p point
+ */
+inline QgsGeometry* pointGeometry(const QgsPoint& p)
+{
+  size_t size = 1 + 4 + 2 * sizeof(double);
+  unsigned char* wkb = new unsigned char[size];
+  unsigned char* q = wkbHeader(wkb, QGis::WKBPoint);
+  q = wkbWrite(q, p.x());
+  wkbWrite(q, p.y());
+  return wkbGeometry(wkb, size);
+}
+
+/**
+ * Returns new multipoint geometry
+ * @param points points
+ */
+inline QgsGeometry* multiPointGeometry(const QgsMultiPoint& points)
+{
+  size_t size = 1 + 4 + 4 + points.size() * (1 + 4 + 2 * sizeof(double));
+  unsigned char* wkb = new unsigned char[size];
+  unsigned char* q = wkbHeader(wkb, QGis::WKBMultiPoint);
+  q = wkbWrite(q, (unsigned int) points.size());
+  for (int i = 0; i < points.size(); ++i)
+  {
+    q = wkbHeader(q, QGis::WKBPoint);
+    q = wkbWrite(q, points[i].x());
+    q = wkbWrite(q, points[i].y());
+  }
+  return wkbGeometry(wkb, size);
+}
+
+/**
+ * Returns new line geometry
+ * @param line polyline
+ */
+inline QgsGeometry* polylineGeometry(const QgsPolyline& line)
+{
+  size_t size = 1 + 4 + 4 + line.size() * 2 * sizeof(double);
+  unsigned char* wkb = new unsigned char[size];
+  unsigned char* q = wkbHeader(wkb, QGis::WKBLineString);
+  q = wkbWrite(q, (unsigned int) line.size());
+  for (int i = 0; i < line.size(); ++i)
+  {
+    q = wkbWrite(q, line[i].x());
+    q = wkbWrite(q, line[i].y());
+  }
+  return wkbGeometry(wkb, size);
+}
+
+#endif
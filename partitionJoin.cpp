@@ -0,0 +1,372 @@
+/***************************************************************************
+  partitionJoin.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "partitionJoin.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// features of both layers kept in memory while joining one partition
+static const int featuresPerPartition = 50000;
+// bytes buffered by all cells before they are written, instead of a buffer per cell
+static const int maxBufferedBytes = 32 * 1024 * 1024;
+// cells are split at most this many times, features covering the whole cell never spread
+static const int maxSplitDepth = 8;
+// record header: feature id, size of the WKB and the bounding box
+static const int headerSize = 2 * sizeof(qint32) + 4 * sizeof(double);
+
+static bool xMinLessThan(const PartitionFeature& a, const PartitionFeature& b)
+{
+  return a.bb.xMinimum() < b.bb.xMinimum();
+}
+
+/**
+ * Returns bounding box stored in the record header
+ */
+static QgsRectangle recordBox(const char* header)
+{
+  double box[4];
+  memcpy(box, header + 2 * sizeof(qint32), sizeof(box));
+  return QgsRectangle(box[0], box[1], box[2], box[3]);
+}
+
+PartitionJoin::PartitionJoin(const QgsRectangle& extent, int side, double margin)
+{
+  mExtent = extent;
+  mSide = qMax(1, side);
+  mMargin = margin;
+  mBufferedBytes = 0;
+
+  double width = extent.width() / mSide;
+  double height = extent.height() / mSide;
+  for (int r = 0; r < mSide; ++r)
+    for (int c = 0; c < mSide; ++c)
+    {
+      PartitionCell cell;
+      cell.rect = QgsRectangle(extent.xMinimum() + c * width, extent.yMinimum() + r * height,
+                               extent.xMinimum() + (c + 1) * width, extent.yMinimum() + (r + 1) * height);
+      cell.children = -1;
+      cell.depth = 0;
+      cell.count[0] = cell.count[1] = 0;
+      mCells << cell;
+    }
+
+  mBuffers[0].resize(mCells.size());
+  mBuffers[1].resize(mCells.size());
+}
+
+PartitionJoin::~PartitionJoin()
+{
+  if (mDirectory.isEmpty())
+    return;
+
+  QDir dir(mDirectory);
+  for (int c = 0; c < mCells.size(); ++c)
+  {
+    dir.remove(fileName(0, c));
+    dir.remove(fileName(1, c));
+  }
+  QDir::temp().rmdir(mDirectory);
+}
+
+int PartitionJoin::gridSide(long featureCount)
+{
+  return qMax(1, (int) ceil(sqrt((double) featureCount / featuresPerPartition)));
+}
+
+bool PartitionJoin::open()
+{
+  QString name = QString("topol-%1-%2").arg(QCoreApplication::applicationPid()).arg((qulonglong) this, 0, 16);
+  if (!QDir::temp().mkpath(name))
+    return false;
+
+  mDirectory = QDir::temp().absoluteFilePath(name);
+  return true;
+}
+
+int PartitionJoin::column(double x) const
+{
+  if (mExtent.width() <= 0)
+    return 0;
+  return qBound(0, (int) ((x - mExtent.xMinimum()) / mExtent.width() * mSide), mSide - 1);
+}
+
+int PartitionJoin::row(double y) const
+{
+  if (mExtent.height() <= 0)
+    return 0;
+  return qBound(0, (int) ((y - mExtent.yMinimum()) / mExtent.height() * mSide), mSide - 1);
+}
+
+int PartitionJoin::cellAt(double x, double y) const
+{
+  // quadrants are picked the same way records are distributed into them
+  int cell = row(y) * mSide + column(x);
+  while (mCells[cell].children >= 0)
+  {
+    QgsPoint center = mCells[cell].rect.center();
+    cell = mCells[cell].children + (y >= center.y() ? 2 : 0) + (x >= center.x() ? 1 : 0);
+  }
+  return cell;
+}
+
+QString PartitionJoin::fileName(int layer, int cell) const
+{
+  return QString("%1/%2-%3").arg(mDirectory).arg(layer).arg(cell);
+}
+
+void PartitionJoin::add(int layer, QgsFeature& f)
+{
+  QgsGeometry* g = f.geometry();
+  QgsRectangle bb = g->boundingBox();
+  double margin = layer ? 0 : mMargin;
+
+  // record: feature id, size of the WKB, the bounding box and the WKB
+  qint32 id = f.id();
+  quint32 size = g->wkbSize();
+  double box[4] = { bb.xMinimum(), bb.yMinimum(), bb.xMaximum(), bb.yMaximum() };
+  QByteArray record;
+  record.append((const char*) &id, sizeof(id));
+  record.append((const char*) &size, sizeof(size));
+  record.append((const char*) box, sizeof(box));
+  record.append((const char*) g->asWkb(), size);
+
+  for (int r = row(bb.yMinimum() - margin); r <= row(bb.yMaximum() + margin); ++r)
+    for (int c = column(bb.xMinimum() - margin); c <= column(bb.xMaximum() + margin); ++c)
+      append(layer, r * mSide + c, record);
+}
+
+void PartitionJoin::append(int layer, int cell, const QByteArray& record)
+{
+  mBuffers[layer][cell].append(record);
+  mCells[cell].count[layer]++;
+  mBufferedBytes += record.size();
+
+  if (mBufferedBytes >= maxBufferedBytes)
+    flushAll();
+}
+
+void PartitionJoin::finish()
+{
+  flushAll();
+
+  // quadrants are appended behind the split cells and checked in turn
+  for (int c = 0; c < mCells.size(); ++c)
+  {
+    const PartitionCell& cell = mCells[c];
+    if (cell.children >= 0 || cell.depth >= maxSplitDepth || cell.count[0] + cell.count[1] <= featuresPerPartition)
+      continue;
+
+    int total = cell.count[0] + cell.count[1];
+    split(c);
+    flushAll();
+
+    // features covering the whole cell reach every quadrant, they are not split further
+    int children = mCells[c].children;
+    for (int q = 0; q < 4; ++q)
+      if (mCells[children + q].count[0] + mCells[children + q].count[1] >= total)
+        mCells[children + q].depth = maxSplitDepth;
+  }
+
+  // cells without features of both layers have no pairs
+  mPartitions.clear();
+  for (int c = 0; c < mCells.size(); ++c)
+    if (mCells[c].children < 0 && mCells[c].count[0] && mCells[c].count[1])
+      mPartitions << c;
+}
+
+void PartitionJoin::split(int cell)
+{
+  QgsRectangle rect = mCells[cell].rect;
+  QgsPoint center = rect.center();
+  int children = mCells.size();
+
+  for (int q = 0; q < 4; ++q)
+  {
+    PartitionCell child;
+    child.rect = QgsRectangle(q & 1 ? center.x() : rect.xMinimum(), q & 2 ? center.y() : rect.yMinimum(),
+                              q & 1 ? rect.xMaximum() : center.x(), q & 2 ? rect.yMaximum() : center.y());
+    child.children = -1;
+    child.depth = mCells[cell].depth + 1;
+    child.count[0] = child.count[1] = 0;
+    mCells << child;
+    mBuffers[0] << QByteArray();
+    mBuffers[1] << QByteArray();
+  }
+  mCells[cell].children = children;
+
+  for (int layer = 0; layer < 2; ++layer)
+  {
+    double margin = layer ? 0 : mMargin;
+
+    // records are streamed, the cell may not fit in memory
+    QFile file(fileName(layer, cell));
+    if (!file.open(QIODevice::ReadOnly))
+      continue;
+
+    while (true)
+    {
+      QByteArray record = file.read(headerSize);
+      if (record.size() < headerSize)
+        break;
+
+      quint32 size;
+      memcpy(&size, record.constData() + sizeof(qint32), sizeof(size));
+      record.append(file.read(size));
+      if (record.size() < headerSize + (int) size)
+        break;
+
+      // a box is moved to the quadrants cellAt() may pick for its points
+      QgsRectangle bb = recordBox(record.constData());
+      bool left = bb.xMinimum() - margin < center.x();
+      bool right = bb.xMaximum() + margin >= center.x();
+      bool bottom = bb.yMinimum() - margin < center.y();
+      bool top = bb.yMaximum() + margin >= center.y();
+
+      if (bottom && left)
+        append(layer, children, record);
+      if (bottom && right)
+        append(layer, children + 1, record);
+      if (top && left)
+        append(layer, children + 2, record);
+      if (top && right)
+        append(layer, children + 3, record);
+    }
+
+    file.close();
+    file.remove();
+  }
+}
+
+void PartitionJoin::flush(int layer, int cell)
+{
+  QByteArray& buffer = mBuffers[layer][cell];
+  if (buffer.isEmpty())
+    return;
+
+  QFile file(fileName(layer, cell));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    std::cout << "Cannot write partition file " << file.fileName().toStdString() << "!\n" << std::flush;
+  else
+    file.write(buffer);
+
+  // the memory is released, not just the content
+  mBufferedBytes -= buffer.size();
+  buffer = QByteArray();
+}
+
+void PartitionJoin::flushAll()
+{
+  for (int c = 0; c < mCells.size(); ++c)
+  {
+    flush(0, c);
+    flush(1, c);
+  }
+}
+
+void PartitionJoin::read(int layer, int cell, QList<PartitionFeature>& features) const
+{
+  QFile file(fileName(layer, cell));
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  QByteArray data = file.readAll();
+  double margin = layer ? 0 : mMargin;
+
+  int pos = 0;
+  while (pos + headerSize <= data.size())
+  {
+    qint32 id;
+    quint32 size;
+    memcpy(&id, data.constData() + pos, sizeof(id));
+    memcpy(&size, data.constData() + pos + sizeof(id), sizeof(size));
+    QgsRectangle bb = recordBox(data.constData() + pos);
+    pos += headerSize;
+
+    if (pos + (int) size > data.size())
+      break;
+
+    // the geometry takes the WKB buffer over
+    unsigned char* wkb = new unsigned char[size];
+    memcpy(wkb, data.constData() + pos, size);
+    pos += size;
+
+    PartitionFeature pf;
+    pf.id = id;
+    pf.geometry = new QgsGeometry;
+    pf.geometry->fromWkb(wkb, size);
+    pf.bb = QgsRectangle(bb.xMinimum() - margin, bb.yMinimum() - margin, bb.xMaximum() + margin, bb.yMaximum() + margin);
+    features << pf;
+  }
+}
+
+void PartitionJoin::candidates(int partition, QList<PartitionFeature>& first, QList<PartitionFeature>& second,
+                               QList<QPair<int, int> >& pairs) const
+{
+  int cell = mPartitions[partition];
+  read(0, cell, first);
+  read(1, cell, second);
+
+  std::sort(first.begin(), first.end(), xMinLessThan);
+  std::sort(second.begin(), second.end(), xMinLessThan);
+
+  // sweep both lists by the left edge, each box is compared with the boxes
+  // of the other list starting before its right edge
+  int i = 0, j = 0;
+  while (i < first.size() && j < second.size())
+  {
+    if (first[i].bb.xMinimum() <= second[j].bb.xMinimum())
+    {
+      const QgsRectangle& a = first[i].bb;
+      for (int k = j; k < second.size() && second[k].bb.xMinimum() <= a.xMaximum(); ++k)
+      {
+        const QgsRectangle& b = second[k].bb;
+        if (b.yMaximum() < a.yMinimum() || b.yMinimum() > a.yMaximum())
+          continue;
+
+        // the pair belongs to the partition of the lower left corner of the box intersection
+        double x = qMax(a.xMinimum(), b.xMinimum());
+        double y = qMax(a.yMinimum(), b.yMinimum());
+        if (cellAt(x, y) == cell)
+          pairs << QPair<int, int>(i, k);
+      }
+      ++i;
+    }
+    else
+    {
+      const QgsRectangle& b = second[j].bb;
+      for (int k = i; k < first.size() && first[k].bb.xMinimum() <= b.xMaximum(); ++k)
+      {
+        const QgsRectangle& a = first[k].bb;
+        if (a.yMaximum() < b.yMinimum() || a.yMinimum() > b.yMaximum())
+          continue;
+
+        double x = qMax(a.xMinimum(), b.xMinimum());
+        double y = qMax(a.yMinimum(), b.yMinimum());
+        if (cellAt(x, y) == cell)
+          pairs << QPair<int, int>(k, j);
+      }
+      ++j;
+    }
+  }
+}
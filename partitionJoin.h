@@ -0,0 +1,182 @@
+/***************************************************************************
+  partitionJoin.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PARTITIONJOIN_H
+#define PARTITIONJOIN_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include <qgsfeature.h>
+#include <qgsgeometry.h>
+#include <qgsrectangle.h>
+
+class PartitionFeature
+{
+public:
+  int id;
+  // read from the partition file, owned by the list it was read into
+  QgsGeometry* geometry;
+  // bounding box, grown by the join margin for the first layer
+  QgsRectangle bb;
+};
+
+/**
+ * Cell of the partition grid, split into four quadrants while it holds too many features
+ */
+class PartitionCell
+{
+public:
+  // cell area, features outside the join extent belong to the border cells
+  QgsRectangle rect;
+  // first of the four child cells once the cell is split, -1 for a partition
+  int children;
+  // number of splits the cell is made by, cells at the limit are not split
+  int depth;
+  // records written to the cell per layer
+  int count[2];
+};
+
+class PartitionMatch
+{
+public:
+  int id1;
+  int id2;
+  QgsGeometry geometry1;
+  QgsGeometry geometry2;
+};
+
+/**
+ * Partition based spatial merge join of two layers too large to be kept
+ * in memory. Features of both layers are written to the files of all grid
+ * cells their bounding boxes reach, then the cells are joined one by one
+ * in memory. A pair of boxes meeting in several cells is reported only in
+ * the cell containing the lower left corner of their intersection.
+ * Cells holding too many features of clustered layers are split into
+ * quadrants until they fit, so the partitions are bounded by feature count.
+ */
+class PartitionJoin
+{
+public:
+  /**
+   * Constructor
+   * @param extent extent of both layers, features outside go to the border cells
+   * @param side number of grid columns and rows
+   * @param margin distance the boxes of the first layer are grown by, the tolerance of close features
+   */
+  PartitionJoin(const QgsRectangle& extent, int side, double margin);
+  /**
+   * Removes the partition files
+   */
+  ~PartitionJoin();
+
+  /**
+   * Returns side of the initial grid keeping partitions of evenly spread
+   * features small enough to be joined in memory
+   * @param featureCount number of features of both layers
+   */
+  static int gridSide(long featureCount);
+
+  /**
+   * Creates the directory of the partition files in the temporary directory
+   * Returns false if it could not be created.
+   */
+  bool open();
+  /**
+   * Writes the feature to the partitions its bounding box reaches
+   * @param layer 0 for the first layer, 1 for the second one
+   * @param f feature with geometry
+   */
+  void add(int layer, QgsFeature& f);
+  /**
+   * Writes the features still buffered and splits cells holding too many
+   * features, must be called before joining
+   */
+  void finish();
+
+  /**
+   * Returns number of partitions to be joined, cells with features of both layers;
+   * known once finish() was called
+   */
+  int partitionCount() const { return mPartitions.size(); }
+  double margin() const { return mMargin; }
+
+  /**
+   * Reads features of both layers in the partition and finds pairs of their
+   * intersecting bounding boxes that belong to the partition
+   * @param partition partition number
+   * @param first features of the first layer to be filled, the caller deletes their geometries
+   * @param second features of the second layer to be filled, the caller deletes their geometries
+   * @param pairs positions of the pairs in the two lists
+   */
+  void candidates(int partition, QList<PartitionFeature>& first, QList<PartitionFeature>& second,
+                  QList<QPair<int, int> >& pairs) const;
+
+private:
+  QgsRectangle mExtent;
+  int mSide;
+  double mMargin;
+  QString mDirectory;
+  // grid cells first, then the quadrants of the split cells
+  QVector<PartitionCell> mCells;
+  // cells joined as partitions
+  QVector<int> mPartitions;
+  // records not written yet, per layer and cell
+  QVector<QByteArray> mBuffers[2];
+  // bytes held by all buffers
+  int mBufferedBytes;
+
+  /**
+   * Returns grid column or row of the coordinate, clamped to the grid
+   */
+  int column(double x) const;
+  int row(double y) const;
+  /**
+   * Returns cell without quadrants the point belongs to, points outside
+   * the extent belong to the nearest one
+   */
+  int cellAt(double x, double y) const;
+  /**
+   * Returns file name of the cell
+   */
+  QString fileName(int layer, int cell) const;
+  /**
+   * Buffers the record of the cell, all buffers are written once they hold too much
+   */
+  void append(int layer, int cell, const QByteArray& record);
+  /**
+   * Appends the buffered records to the cell file
+   */
+  void flush(int layer, int cell);
+  /**
+   * Writes all buffers
+   */
+  void flushAll();
+  /**
+   * Moves the records of the cell into its four quadrants
+   */
+  void split(int cell);
+  /**
+   * Reads features of one layer in the cell
+   */
+  void read(int layer, int cell, QList<PartitionFeature>& features) const;
+};
+
+#endif
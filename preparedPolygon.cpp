@@ -0,0 +1,101 @@
+/***************************************************************************
+  preparedPolygon.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "preparedPolygon.h"
+
+#include "nativeFunctions.h"
+
+PreparedPolygon::PreparedPolygon(QgsGeometry* g)
+{
+  QList<QgsPolyline> rings;
+  linearParts(g, rings);
+
+  mExtent = g->boundingBox();
+  for (int r = 0; r < rings.size(); ++r)
+    for (int i = 1; i < rings[r].size(); ++i)
+    {
+      PreparedEdge e;
+      e.p1 = rings[r][i-1];
+      e.p2 = rings[r][i];
+      mEdges << e;
+    }
+
+  // about two edges per band for short polygon edges
+  mBandCount = qBound(1, mEdges.size() / 2, 4096);
+  mBandHeight = mExtent.height() / mBandCount;
+  mBandStart.fill(0, mBandCount + 1);
+
+  // count edges of every band, then fill them in
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    QVector<int> next;
+    if (pass)
+    {
+      for (int b = 0; b < mBandCount; ++b)
+        mBandStart[b+1] += mBandStart[b];
+      mBandEdges.resize(mBandStart[mBandCount]);
+      next = mBandStart;
+    }
+
+    for (int e = 0; e < mEdges.size(); ++e)
+    {
+      int first = band(qMin(mEdges[e].p1.y(), mEdges[e].p2.y()));
+      int last = band(qMax(mEdges[e].p1.y(), mEdges[e].p2.y()));
+      for (int b = first; b <= last; ++b)
+      {
+        if (pass)
+          mBandEdges[next[b]++] = e;
+        else
+          ++mBandStart[b+1];
+      }
+    }
+  }
+}
+
+int PreparedPolygon::band(double y) const
+{
+  if (mBandHeight <= 0)
+    return 0;
+
+  return qBound(0, (int) ((y - mExtent.yMinimum()) / mBandHeight), mBandCount - 1);
+}
+
+bool PreparedPolygon::covers(const QgsPoint& p) const
+{
+  if (p.x() < mExtent.xMinimum() || p.x() > mExtent.xMaximum() ||
+      p.y() < mExtent.yMinimum() || p.y() > mExtent.yMaximum())
+    return false;
+
+  // even-odd crossings of a ray going right, over the edges reaching the band only
+  bool inside = false;
+  int b = band(p.y());
+  for (int i = mBandStart[b]; i < mBandStart[b+1]; ++i)
+  {
+    const QgsPoint& a = mEdges[mBandEdges[i]].p1;
+    const QgsPoint& c = mEdges[mBandEdges[i]].p2;
+
+    int side = orientationSign(a, c, p);
+    if (side == 0 && withinSegmentBox(a, c, p))
+      return true;
+
+    // the point lies left of an upward edge or right of a downward one
+    if ((a.y() > p.y()) != (c.y() > p.y()) && (c.y() > a.y() ? side > 0 : side < 0))
+      inside = !inside;
+  }
+
+  return inside;
+}
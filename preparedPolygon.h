@@ -0,0 +1,70 @@
+/***************************************************************************
+  preparedPolygon.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PREPAREDPOLYGON_H
+#define PREPAREDPOLYGON_H
+
+#include <QVector>
+
+#include <qgsgeometry.h>
+#include <qgspoint.h>
+#include <qgsrectangle.h>
+
+class PreparedEdge
+{
+public:
+  QgsPoint p1;
+  QgsPoint p2;
+};
+
+/**
+ * Polygon or multipolygon with its edges binned into horizontal bands,
+ * so that locating a point tests only the edges of the band it falls in.
+ * Meant to be built once and queried with many points.
+ */
+class PreparedPolygon
+{
+public:
+  /**
+   * Constructor
+   * @param g polygon or multipolygon geometry
+   */
+  PreparedPolygon(QgsGeometry* g);
+
+  /**
+   * Checks whether the point lies inside the polygon or on its boundary
+   * @param p tested point
+   */
+  bool covers(const QgsPoint& p) const;
+
+private:
+  QVector<PreparedEdge> mEdges;
+  QgsRectangle mExtent;
+  int mBandCount;
+  double mBandHeight;
+  // edges of band b are mBandEdges[mBandStart[b]..mBandStart[b+1]-1]
+  QVector<int> mBandStart;
+  QVector<int> mBandEdges;
+
+  /**
+   * Returns band of the y coordinate, clamped to existing bands
+   * @param y y coordinate
+   */
+  int band(double y) const;
+};
+
+#endif
@@ -0,0 +1,94 @@
+/***************************************************************************
+  robustPredicates.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "robustPredicates.h"
+
+// splits a double into two halves of 26 bits, 2^27 + 1
+static const double splitter = 134217729.0;
+
+/**
+ * Computes the product of a and b as x + y exactly, x being the rounded product
+ */
+static void twoProduct(double a, double b, double& x, double& y)
+{
+  x = a * b;
+
+  double c = splitter * a;
+  double aHi = c - (c - a);
+  double aLo = a - aHi;
+  c = splitter * b;
+  double bHi = c - (c - b);
+  double bLo = b - bHi;
+
+  y = aLo * bLo - (((x - aHi * bHi) - aLo * bHi) - aHi * bLo);
+}
+
+/**
+ * Computes the sum of a and b as x + y exactly, x being the rounded sum
+ */
+static void twoSum(double a, double b, double& x, double& y)
+{
+  x = a + b;
+  double bVirtual = x - a;
+  double aVirtual = x - bVirtual;
+  y = (a - aVirtual) + (b - bVirtual);
+}
+
+/**
+ * Adds the value to the expansion, a sum of nonoverlapping components
+ * ordered by increasing magnitude; zero components are dropped
+ */
+static void growExpansion(double* e, int& size, double value)
+{
+  int n = 0;
+  double q = value;
+  for (int i = 0; i < size; ++i)
+  {
+    double h;
+    twoSum(q, e[i], q, h);
+    if (h != 0)
+      e[n++] = h;
+  }
+  if (q != 0)
+    e[n++] = q;
+  size = n;
+}
+
+int exactOrientationSign(const QgsPoint& a, const QgsPoint& b, const QgsPoint& c)
+{
+  // (bx - ax)(cy - ay) - (by - ay)(cx - ax) expanded into products of the coordinates
+  double terms[6][2];
+  twoProduct(b.x(), c.y(), terms[0][0], terms[0][1]);
+  twoProduct(-b.x(), a.y(), terms[1][0], terms[1][1]);
+  twoProduct(-a.x(), c.y(), terms[2][0], terms[2][1]);
+  twoProduct(-b.y(), c.x(), terms[3][0], terms[3][1]);
+  twoProduct(b.y(), a.x(), terms[4][0], terms[4][1]);
+  twoProduct(a.y(), c.x(), terms[5][0], terms[5][1]);
+
+  double expansion[13];
+  int size = 0;
+  for (int i = 0; i < 6; ++i)
+  {
+    growExpansion(expansion, size, terms[i][1]);
+    growExpansion(expansion, size, terms[i][0]);
+  }
+
+  // the largest component decides the sign of the sum
+  if (!size)
+    return 0;
+  return expansion[size - 1] > 0 ? 1 : -1;
+}
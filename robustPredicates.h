@@ -0,0 +1,66 @@
+/***************************************************************************
+  robustPredicates.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef ROBUSTPREDICATES_H
+#define ROBUSTPREDICATES_H
+
+#include <cmath>
+
+#include <qgspoint.h>
+
+/*
+ * Adaptive precision orientation test: the floating point determinant
+ * is trusted when it is farther from zero than its rounding error,
+ * nearly collinear points are decided by exact arithmetic
+ * (J. R. Shewchuk, Adaptive Precision Floating-Point Arithmetic
+ * and Fast Robust Geometric Predicates)
+ */
+
+// error bound of the floating point determinant relative to its terms, (3 + 16e)e with e = 2^-53
+static const double orientationErrorBound = (3.0 + 16.0 * 1.1102230246251565e-16) * 1.1102230246251565e-16;
+
+/**
+ * Returns sign of the orientation determinant computed exactly
+ * @param a first point
+ * @param b second point
+ * @param c tested point
+ */
+int exactOrientationSign(const QgsPoint& a, const QgsPoint& b, const QgsPoint& c);
+
+/**
+ * Returns 1 when c lies to the left of the directed line ab, -1 when
+ * it lies to the right and 0 when the points are exactly collinear
+ * @param a first point
+ * @param b second point
+ * @param c tested point
+ */
+inline int orientationSign(const QgsPoint& a, const QgsPoint& b, const QgsPoint& c)
+{
+  double detLeft = (b.x() - a.x()) * (c.y() - a.y());
+  double detRight = (b.y() - a.y()) * (c.x() - a.x());
+  double det = detLeft - detRight;
+  double bound = orientationErrorBound * (fabs(detLeft) + fabs(detRight));
+
+  if (det > bound)
+    return 1;
+  if (-det > bound)
+    return -1;
+
+  return exactOrientationSign(a, b, c);
+}
+
+#endif
@@ -47,6 +47,7 @@ rulesDialog::rulesDialog(QList<QString> layerList, QMap<QString, test> testMap,
   mTestConfMap = testMap;
   mTestTable->setSelectionBehavior(QAbstractItemView::SelectRows);
   mTestBox->addItems(mTestConfMap.keys());
+  mIndexBox->addItems(TopolIndex::typeNames());
 
   QgsMapLayerRegistry* layerRegistry = QgsMapLayerRegistry::instance();
 
@@ -92,6 +93,7 @@ void rulesDialog::readTest(int index, QgsMapLayerRegistry* layerRegistry)
   QString layer1Id;
   QString layer2Id;
   QString tolerance;
+  QString indexName;
   QgsProject* project = QgsProject::instance();
   QString postfix = QString("%1").arg(index);
 
@@ -99,6 +101,7 @@ void rulesDialog::readTest(int index, QgsMapLayerRegistry* layerRegistry)
   tolerance = project->readEntry( "Topol", "/tolerance_" + postfix, "" );
   layer1Id = project->readEntry( "Topol", "/layer1_" + postfix, "" );
   layer2Id = project->readEntry( "Topol", "/layer2_" + postfix, "" );
+  indexName = project->readEntry( "Topol", "/index_" + postfix, TopolIndex::typeNames().first() );
 
   QgsVectorLayer* l1;
   if (!(QgsVectorLayer*)layerRegistry->mapLayers().contains(layer1Id))
@@ -154,6 +157,10 @@ void rulesDialog::readTest(int index, QgsMapLayerRegistry* layerRegistry)
   mTestTable->setItem(row, 4, newItem);
   newItem = new QTableWidgetItem(layer2Id);
   mTestTable->setItem(row, 5, newItem);
+
+  newItem = new QTableWidgetItem(indexName);
+  newItem->setFlags(newItem->flags() & ~Qt::ItemIsEditable);
+  mTestTable->setItem(row, 6, newItem);
 }
 
 void rulesDialog::projectRead()
@@ -164,6 +171,8 @@ void rulesDialog::projectRead()
 
   for (int i = 0; i < testCount; ++i)
     readTest(i, layerRegistry);
+
+  emit testsRead();
 }
 
 void rulesDialog::showControls(const QString& testName)
@@ -247,6 +256,9 @@ void rulesDialog::addTest()
   mTestTable->setItem(row, 4, newItem);
   newItem = new QTableWidgetItem(layer2ID);
   mTestTable->setItem(row, 5, newItem);
+  newItem = new QTableWidgetItem(mIndexBox->currentText());
+  newItem->setFlags(newItem->flags() & ~Qt::ItemIsEditable);
+  mTestTable->setItem(row, 6, newItem);
 
   // save state to the project file.....
   QString postfix = QString("%1").arg(row);
@@ -257,12 +269,14 @@ void rulesDialog::addTest()
   project->writeEntry( "Topol", "/tolerance_" + postfix, QString("%1").arg(mToleranceBox->value()));
   project->writeEntry( "Topol", "/layer1_" + postfix, layer1ID );
   project->writeEntry( "Topol", "/layer2_" + postfix, layer2ID );
+  project->writeEntry( "Topol", "/index_" + postfix, mIndexBox->currentText() );
 
   // reset controls to default 
   mTestBox->setCurrentIndex(0);
   mLayer1Box->setCurrentIndex(0);
   mLayer2Box->setCurrentIndex(0);
   mToleranceBox->setValue(0);
+  mIndexBox->setCurrentIndex(0);
 }
 
 void rulesDialog::deleteTest()
@@ -95,6 +95,12 @@ private slots:
    * @param layerId layer ID
    */
   void removeLayer(QString layerId);
+
+signals:
+  /*
+   * Informs that tests were read from the project
+   */
+  void testsRead();
 };
 
 #endif
@@ -0,0 +1,70 @@
+/***************************************************************************
+  snapGrid.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "snapGrid.h"
+
+#include <cmath>
+#include <cstring>
+
+/**
+ * Returns bit pattern of the coordinate, used as exact hash key
+ */
+static qint64 coordinateKey(double d)
+{
+  // make -0 and 0 the same key
+  d += 0.0;
+  qint64 key;
+  memcpy(&key, &d, sizeof(key));
+  return key;
+}
+
+SnapGrid::SnapGrid(double tolerance)
+{
+  mTolerance = tolerance;
+}
+
+int SnapGrid::snap(const QgsPoint& p)
+{
+  if (mTolerance > 0)
+  {
+    qint64 cx = (qint64)floor(p.x() / mTolerance);
+    qint64 cy = (qint64)floor(p.y() / mTolerance);
+    double sqrTolerance = mTolerance * mTolerance;
+
+    for (qint64 x = cx - 1; x <= cx + 1; ++x)
+      for (qint64 y = cy - 1; y <= cy + 1; ++y)
+      {
+        QVector<int> cell = mCells.value(qMakePair(x, y));
+        for (int i = 0; i < cell.size(); ++i)
+          if (mPoints[cell[i]].sqrDist(p) <= sqrTolerance)
+            return cell[i];
+      }
+
+    mCells[qMakePair(cx, cy)] << mPoints.size();
+  }
+  else
+  {
+    QVector<int>& cell = mCells[qMakePair(coordinateKey(p.x()), coordinateKey(p.y()))];
+    if (!cell.isEmpty())
+      return cell.first();
+
+    cell << mPoints.size();
+  }
+
+  mPoints << p;
+  return mPoints.size() - 1;
+}
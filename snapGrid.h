@@ -0,0 +1,60 @@
+/***************************************************************************
+  snapGrid.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SNAPGRID_H
+#define SNAPGRID_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+#include <qgspoint.h>
+
+/**
+ * Merges points lying within the tolerance into one, using a hash
+ * of grid cells of the tolerance size. Without a tolerance only
+ * equal points are merged.
+ */
+class SnapGrid
+{
+public:
+  /**
+   * Constructor
+   * @param tolerance distance within which points are merged
+   */
+  SnapGrid(double tolerance);
+
+  /**
+   * Returns index of the point the given one snaps to,
+   * the point is added when there is none within the tolerance
+   * @param p point
+   */
+  int snap(const QgsPoint& p);
+  /**
+   * Returns all distinct points
+   */
+  const QVector<QgsPoint>& points() const { return mPoints; }
+  double tolerance() const { return mTolerance; }
+
+private:
+  double mTolerance;
+  QVector<QgsPoint> mPoints;
+  // grid cell to points in it
+  QHash<QPair<qint64, qint64>, QVector<int> > mCells;
+};
+
+#endif
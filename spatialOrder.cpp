@@ -0,0 +1,140 @@
+/***************************************************************************
+  spatialOrder.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "spatialOrder.h"
+
+#include <QPair>
+#include <QVector>
+#include <QtAlgorithms>
+
+// side of the grid the extent is quantized to
+static const quint32 sGridSize = 1 << 16;
+
+quint64 hilbertKey(quint32 x, quint32 y)
+{
+  quint64 d = 0;
+  for (quint32 s = sGridSize / 2; s > 0; s /= 2)
+  {
+    quint32 rx = (x & s) > 0;
+    quint32 ry = (y & s) > 0;
+    d += (quint64)s * s * ((3 * rx) ^ ry);
+
+    // rotate the quadrant so that the curve keeps its orientation
+    if (!ry)
+    {
+      if (rx)
+      {
+        x = sGridSize - 1 - x;
+        y = sGridSize - 1 - y;
+      }
+      qSwap(x, y);
+    }
+  }
+
+  return d;
+}
+
+quint64 zOrderKey(quint32 x, quint32 y)
+{
+  quint64 d = 0;
+  for (int bit = 0; bit < 16; ++bit)
+  {
+    d |= (quint64)((x >> bit) & 1) << (2 * bit);
+    d |= (quint64)((y >> bit) & 1) << (2 * bit + 1);
+  }
+
+  return d;
+}
+
+/**
+ * Computes curve keys of the bounding box centres,
+ * returns pairs of the key and the position of the box
+ */
+static QVector<QPair<quint64, int> > curveKeys(const QVector<QgsRectangle>& boxes, SpatialOrder order)
+{
+  QVector<QPair<quint64, int> > keys(boxes.size());
+  if (boxes.isEmpty())
+    return keys;
+
+  QgsRectangle extent = boxes.first();
+  for (int i = 1; i < boxes.size(); ++i)
+  {
+    QgsRectangle bb = boxes[i];
+    extent.combineExtentWith(&bb);
+  }
+
+  double width = extent.width() > 0 ? extent.width() : 1;
+  double height = extent.height() > 0 ? extent.height() : 1;
+
+  for (int i = 0; i < boxes.size(); ++i)
+  {
+    QgsPoint c = boxes[i].center();
+    quint32 x = (quint32)((c.x() - extent.xMinimum()) / width * (sGridSize - 1));
+    quint32 y = (quint32)((c.y() - extent.yMinimum()) / height * (sGridSize - 1));
+    keys[i] = qMakePair(order == OrderHilbert ? hilbertKey(x, y) : zOrderKey(x, y), i);
+  }
+
+  qSort(keys.begin(), keys.end());
+  return keys;
+}
+
+void sortFeatures(QList<FeatureLayer>& features, SpatialOrder order)
+{
+  if (order == OrderNone)
+    return;
+
+  QVector<QgsRectangle> boxes(features.size());
+  for (int i = 0; i < features.size(); ++i)
+    boxes[i] = features[i].feature.geometry()->boundingBox();
+
+  QVector<QPair<quint64, int> > keys = curveKeys(boxes, order);
+
+  QList<FeatureLayer> sorted;
+  sorted.reserve(features.size());
+  for (int i = 0; i < keys.size(); ++i)
+    sorted << features[keys[i].second];
+
+  features = sorted;
+}
+
+FeatureStore sortFeatures(FeatureStore& features, SpatialOrder order)
+{
+  if (order == OrderNone)
+    return features;
+
+  QVector<QgsRectangle> boxes(features.size());
+  for (int i = 0; i < features.size(); ++i)
+    boxes[i] = features[i].feature.geometry()->boundingBox();
+
+  QVector<QPair<quint64, int> > keys = curveKeys(boxes, order);
+
+  // features are copied in curve order, so are their geometries,
+  // which keeps neighbouring geometries close in memory as well
+  FeatureStore sorted;
+  sorted.reserve(features.size());
+  for (int i = 0; i < keys.size(); ++i)
+    sorted.add(features[keys[i].second]);
+
+  return sorted;
+}
+
+QStringList spatialOrderNames()
+{
+  QStringList names;
+  names << "Provider order" << "Hilbert order" << "Z-order";
+  return names;
+}
@@ -0,0 +1,61 @@
+/***************************************************************************
+  spatialOrder.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SPATIALORDER_H
+#define SPATIALORDER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <qgsrectangle.h>
+
+#include "featureStore.h"
+#include "topolError.h"
+
+enum SpatialOrder { OrderNone, OrderHilbert, OrderZ };
+
+/**
+ * Returns position of the cell on the Hilbert curve filling a 65536x65536 grid
+ * @param x cell column
+ * @param y cell row
+ */
+quint64 hilbertKey(quint32 x, quint32 y);
+/**
+ * Returns position of the cell on the Z-order (Morton) curve filling a 65536x65536 grid
+ * @param x cell column
+ * @param y cell row
+ */
+quint64 zOrderKey(quint32 x, quint32 y);
+/**
+ * Sorts features by the curve key of their bounding box centre
+ * @param features features to be sorted
+ * @param order curve to use, OrderNone leaves the list untouched
+ */
+void sortFeatures(QList<FeatureLayer>& features, SpatialOrder order);
+/**
+ * Returns a copy of the store with features arranged along the curve
+ * @param features features to be sorted
+ * @param order curve to use, OrderNone returns the store as it is
+ */
+FeatureStore sortFeatures(FeatureStore& features, SpatialOrder order);
+/**
+ * Returns user visible names of the orderings, ordered by the SpatialOrder values
+ */
+QStringList spatialOrderNames();
+
+#endif
@@ -0,0 +1,74 @@
+/***************************************************************************
+  testRun.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "testRun.h"
+
+#include "errorArena.h"
+#include "geosContext.h"
+
+TestRun::TestRun(QString testName, QgsVectorLayer* layer1, QgsVectorLayer* layer2, ValidateType type,
+                 double tolerance, IndexType indexType, SpatialOrder order)
+{
+  mTestName = testName;
+  mLayer1 = layer1;
+  mTargets << layer2;
+  mValidateType = type;
+  mTolerance = tolerance;
+  mIndexType = indexType;
+  mSpatialOrder = order;
+  if (layer1)
+    mWorkingCrs = layer1->srs();
+  mMaxErrors = 0;
+  mSampleSize = 0;
+  mPartitioned = false;
+  mProgressOffset = 0;
+  mErrorCounts << 0;
+  mTarget = 0;
+  mCancelled = false;
+  mLimitReached = false;
+  mArena = new ErrorArena;
+  mGeos = new GeosContext;
+}
+
+TestRun::~TestRun()
+{
+  delete mArena;
+  delete mGeos;
+}
+
+ErrorArena* TestRun::takeArena()
+{
+  ErrorArena* arena = mArena;
+  mArena = 0;
+  return arena;
+}
+
+void TestRun::setTarget(int target)
+{
+  while (mErrorCounts.size() <= target)
+    mErrorCounts << 0;
+
+  mTarget = target;
+  mLimitReached = limitReached(target);
+}
+
+QList<LayerData*> TestRun::takeLayerData()
+{
+  QList<LayerData*> data = mLayerData.values();
+  mLayerData.clear();
+  return data;
+}
@@ -0,0 +1,294 @@
+/***************************************************************************
+  testRun.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TESTRUN_H
+#define TESTRUN_H
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <qgscoordinatereferencesystem.h>
+#include <qgsvectorlayer.h>
+#include <qgsrectangle.h>
+
+#include "spatialOrder.h"
+#include "topolError.h"
+#include "topolIndex.h"
+
+class ErrorArena;
+class GeosContext;
+class LayerData;
+
+enum ValidateType { ValidateAll, ValidateExtent, ValidateSelected };
+
+class TestStatistics
+{
+public:
+  // features of the first layer that were checked
+  int featureCount;
+  int errorCount;
+  // times in milliseconds spent loading the first layer, waiting for the second layer
+  // loaded and indexed meanwhile, sorting features along the space filling curve and in the test itself;
+  // tests checking the features as they are read count the checks in the load time
+  int loadTime;
+  int indexTime;
+  int orderTime;
+  int testTime;
+  // the test of some target stopped after the maximal number of errors
+  bool limitReached;
+  // features the sample was drawn from, 0 if all features were checked
+  int population;
+  // errors of all features estimated from the sample with their 95% interval
+  double estimatedErrors;
+  double errorsLow;
+  double errorsHigh;
+  // errors found against every target layer
+  QList<int> targetErrors;
+
+  TestStatistics()
+  {
+    featureCount = 0;
+    errorCount = 0;
+    limitReached = false;
+    population = 0;
+    estimatedErrors = 0;
+    errorsLow = 0;
+    errorsHigh = 0;
+    loadTime = 0;
+    indexTime = 0;
+    orderTime = 0;
+    testTime = 0;
+  }
+};
+
+/**
+ * Context of one run of a test: its parameters, the checked features,
+ * cancellation and statistics. Every run has its own, so that several
+ * tests can run at once in different threads.
+ */
+class TestRun : public QObject
+{
+Q_OBJECT
+
+public:
+  /**
+   * Constructor
+   * @param testName name of the test
+   * @param layer1 pointer to the first layer
+   * @param layer2 pointer to the second layer, the first target of the test
+   * @param type type what features to validate
+   * @param tolerance possible tolerance
+   * @param indexType spatial index backend for the layers, IndexAuto to pick one from layer statistics
+   * @param order order features are checked in and kept in feature stores
+   */
+  TestRun(QString testName, QgsVectorLayer* layer1, QgsVectorLayer* layer2, ValidateType type,
+          double tolerance, IndexType indexType = IndexAuto, SpatialOrder order = OrderNone);
+  ~TestRun();
+
+  QString testName() const { return mTestName; }
+  QgsVectorLayer* layer1() const { return mLayer1; }
+  QgsVectorLayer* layer2() const { return mTargets.first(); }
+  /**
+   * Adds another layer the first layer is checked against,
+   * its features are read just once for all targets
+   * @param layer target layer
+   */
+  void addTarget(QgsVectorLayer* layer) { mTargets << layer; }
+  QList<QgsVectorLayer*> targets() const { return mTargets; }
+  ValidateType validateType() const { return mValidateType; }
+  double tolerance() const { return mTolerance; }
+  IndexType indexType() const { return mIndexType; }
+  SpatialOrder spatialOrder() const { return mSpatialOrder; }
+  /**
+   * Sets coordinate system all layers are checked in, the one of the first layer
+   * by default; the tolerance is given in its units
+   * @param crs working coordinate system
+   */
+  void setWorkingCrs(const QgsCoordinateReferenceSystem& crs) { mWorkingCrs = crs; }
+  QgsCoordinateReferenceSystem workingCrs() const { return mWorkingCrs; }
+
+  /**
+   * Sets the extent validated with ValidateExtent, the map canvas
+   * is read in the GUI thread before the run starts
+   * @param extent validated extent
+   */
+  void setExtent(const QgsRectangle& extent) { mExtent = extent; }
+  QgsRectangle extent() const { return mExtent; }
+
+  /**
+   * Sets the number of errors after which the test of a target stops, 1 just tells
+   * whether the layer passes the test; every target has its own limit
+   * @param maxErrors maximal number of errors, 0 for no limit
+   */
+  void setMaxErrors(int maxErrors) { mMaxErrors = maxErrors; }
+  int maxErrors() const { return mMaxErrors; }
+  /**
+   * Sets the number of features checked in a stratified random sample,
+   * errors of the other features are estimated
+   * @param sampleSize sample size, 0 to check all features
+   */
+  void setSampleSize(int sampleSize) { mSampleSize = sampleSize; }
+  int sampleSize() const { return mSampleSize; }
+  /**
+   * Sets whether two layer tests supporting it join the layers through
+   * partition files on disk instead of loading them in memory
+   * @param partitioned true for the partitioned join
+   */
+  void setPartitioned(bool partitioned) { mPartitioned = partitioned; }
+  bool partitioned() const { return mPartitioned; }
+  /**
+   * Appends the error found by the test, the run stops once the list holds
+   * one error more than the limit, so that a limit reached means more errors exist
+   * @param errors errors found so far
+   * @param error new error
+   */
+  void addError(ErrorList& errors, TopolError* error)
+  {
+    errors << error;
+    if (mMaxErrors && ++mErrorCounts[mTarget] > mMaxErrors)
+      mLimitReached = true;
+  }
+  /**
+   * Makes the following errors count against the limit of the target,
+   * the run stops only if that target already reached its limit
+   * @param target index of the target
+   */
+  void setTarget(int target);
+  /**
+   * Returns true if the target found more errors than the limit
+   * @param target index of the target
+   */
+  bool limitReached(int target) const { return mMaxErrors && mErrorCounts.value(target) > mMaxErrors; }
+
+  /**
+   * Returns checked features of the first layer
+   */
+  QList<FeatureLayer>& features() { return mFeatures; }
+  /**
+   * Returns statistics of the run
+   */
+  TestStatistics& statistics() { return mStatistics; }
+  /**
+   * Adds time spent ordering features, the targets may be loaded in several threads at once
+   * @param time time in milliseconds
+   */
+  void addOrderTime(int time)
+  {
+    QMutexLocker locker(&mStatisticsMutex);
+    mStatistics.orderTime += time;
+  }
+
+  /**
+   * Returns cached layer data held by the run
+   * @param layerId layer ID
+   */
+  LayerData* layerData(const QString& layerId) const { return mLayerData.value(layerId); }
+  /**
+   * Keeps the layer data until the run ends, called only by the thread running the test
+   * @param layerId layer ID
+   * @param data data acquired from the layer cache
+   */
+  void addLayerData(const QString& layerId, LayerData* data) { mLayerData[layerId] = data; }
+  /**
+   * Returns all layer data held by the run and forgets them
+   */
+  QList<LayerData*> takeLayerData();
+
+  /**
+   * Returns arena the errors of the run are created in
+   */
+  ErrorArena* arena() { return mArena; }
+  /**
+   * Returns the arena and forgets it, the caller deletes it
+   * together with the errors returned by the test
+   */
+  ErrorArena* takeArena();
+
+  /**
+   * Returns GEOS context of the run, used only by the thread running the test;
+   * its worker threads create their own
+   */
+  GeosContext* geos() { return mGeos; }
+
+  /**
+   * Returns true once the run was cancelled, the flag is never reset
+   */
+  bool isCancelled() const { return mCancelled; }
+  /**
+   * Returns true if the test should stop, because it was cancelled or found enough errors
+   */
+  bool isStopped() const { return mCancelled || mLimitReached; }
+  /**
+   * Reports progress of the run, may be called from any thread
+   * @param value process status
+   */
+  void setProgress(int value) { emit progress(mProgressOffset + value); }
+  /**
+   * Sets progress of the targets already checked, the test of the next
+   * target reports its progress from there
+   * @param offset process status of the finished targets
+   */
+  void setProgressOffset(int offset) { mProgressOffset = offset; }
+
+public slots:
+  /**
+   * Cancels the run, the test and its worker threads stop as soon as they notice
+   */
+  void cancel() { mCancelled = true; }
+
+signals:
+  /**
+   * Informs progress dialog about current status
+   * @param value process status
+   */
+  void progress(int value);
+
+private:
+  QString mTestName;
+  QgsVectorLayer* mLayer1;
+  QList<QgsVectorLayer*> mTargets;
+  ValidateType mValidateType;
+  double mTolerance;
+  IndexType mIndexType;
+  SpatialOrder mSpatialOrder;
+  QgsCoordinateReferenceSystem mWorkingCrs;
+  QgsRectangle mExtent;
+
+  QList<FeatureLayer> mFeatures;
+  TestStatistics mStatistics;
+  QMutex mStatisticsMutex;
+  QMap<QString, LayerData*> mLayerData;
+  ErrorArena* mArena;
+  GeosContext* mGeos;
+  int mMaxErrors;
+  int mSampleSize;
+  bool mPartitioned;
+  int mProgressOffset;
+  // errors counted against the limit of every target, the current target
+  QVector<int> mErrorCounts;
+  int mTarget;
+  // read by worker threads of the test
+  volatile bool mCancelled;
+  volatile bool mLimitReached;
+};
+
+#endif
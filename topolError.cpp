@@ -143,6 +143,14 @@ TopolErrorIntersection::TopolErrorIntersection(QgsRectangle theBoundingBox, QgsG
   }
 }
 
+TopolErrorTouch::TopolErrorTouch(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
+{
+  mName = "Touching line ends";
+
+  mFixMap["Delete blue feature"] = &TopolErrorTouch::fixDeleteFirst;
+  mFixMap["Delete red feature"] = &TopolErrorTouch::fixDeleteSecond;
+}
+
 TopolErrorClose::TopolErrorClose(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
 {
   mName = "Features too close";
@@ -164,6 +172,12 @@ TopolErrorInside::TopolErrorInside(QgsRectangle theBoundingBox, QgsGeometry* the
   mFixMap["Delete feature inside"] = &TopolErrorInside::fixDeleteSecond;
 }
 
+TopolErrorOutside::TopolErrorOutside(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
+{
+  mName = "Point outside polygons";
+  mFixMap["Delete point"] = &TopolErrorOutside::fixDeleteFirst;
+}
+
 TopolErrorShort::TopolErrorShort(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
 {
   mName = "Segment too short";
@@ -181,3 +195,45 @@ TopolErrorDangle::TopolErrorDangle(QgsRectangle theBoundingBox, QgsGeometry* the
   mName = "Dangling line";
   mFixMap["Delete feature"] = &TopolErrorDangle::fixDeleteFirst;
 }
+
+TopolErrorPseudo::TopolErrorPseudo(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
+{
+  mName = "Pseudo node";
+  mFixMap["Union to blue feature"] = &TopolErrorPseudo::fixUnionFirst;
+  mFixMap["Union to red feature"] = &TopolErrorPseudo::fixUnionSecond;
+}
+
+TopolErrorOverlap::TopolErrorOverlap(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
+{
+  mName = "Overlapping polygons";
+  mFixMap["Move blue feature"] = &TopolErrorOverlap::fixMoveFirst;
+  mFixMap["Move red feature"] = &TopolErrorOverlap::fixMoveSecond;
+  mFixMap["Union to blue feature"] = &TopolErrorOverlap::fixUnionFirst;
+  mFixMap["Union to red feature"] = &TopolErrorOverlap::fixUnionSecond;
+}
+
+QgsGeometry* TopolErrorOverlap::conflict()
+{
+  // intersecting big polygons is costly, only the errors looked at need it
+  if (!mConflict)
+  {
+    QgsGeometry* g1 = mFeaturePairs.first().feature.geometry();
+    QgsGeometry* g2 = mFeaturePairs[1].feature.geometry();
+    if (g1 && g2)
+      mConflict = g1->intersection(g2);
+  }
+
+  return mConflict;
+}
+
+TopolErrorDuplicate::TopolErrorDuplicate(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
+{
+  mName = "Duplicate geometry";
+  mFixMap["Delete blue feature"] = &TopolErrorDuplicate::fixDeleteFirst;
+  mFixMap["Delete red feature"] = &TopolErrorDuplicate::fixDeleteSecond;
+}
+
+TopolErrorGap::TopolErrorGap(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs) : TopolError(theBoundingBox, theConflict, theFeaturePairs)
+{
+  mName = "Gap";
+}
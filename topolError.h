@@ -146,6 +146,12 @@ public:
   TopolErrorIntersection(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
 };
 
+class TopolErrorTouch : public TopolError
+{
+public:
+  TopolErrorTouch(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
+};
+
 class TopolErrorClose : public TopolError
 {
 public:
@@ -170,6 +176,12 @@ public:
   TopolErrorInside(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
 };
 
+class TopolErrorOutside : public TopolError
+{
+public:
+  TopolErrorOutside(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
+};
+
 class TopolErrorValid : public TopolError
 {
 public:
@@ -182,4 +194,33 @@ public:
   TopolErrorDangle(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
 };
 
+class TopolErrorPseudo : public TopolError
+{
+public:
+  TopolErrorPseudo(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
+};
+
+class TopolErrorOverlap : public TopolError
+{
+public:
+  TopolErrorOverlap(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
+  /**
+   * Returns the overlapping area of the two polygons,
+   * computed on first use when no conflict was given
+   */
+  virtual QgsGeometry* conflict();
+};
+
+class TopolErrorDuplicate : public TopolError
+{
+public:
+  TopolErrorDuplicate(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
+};
+
+class TopolErrorGap : public TopolError
+{
+public:
+  TopolErrorGap(QgsRectangle theBoundingBox, QgsGeometry* theConflict, QList<FeatureLayer> theFeaturePairs);
+};
+
 #endif
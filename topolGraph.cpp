@@ -0,0 +1,180 @@
+/***************************************************************************
+  topolGraph.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "topolGraph.h"
+
+#include <algorithm>
+
+#include "lineNoder.h"
+#include "nativeFunctions.h"
+
+/**
+ * Orders points along a segment by their distance from its start
+ */
+class DistanceLess
+{
+public:
+  DistanceLess(const QgsPoint& start) : mStart(start) {}
+  bool operator()(const QgsPoint& p1, const QgsPoint& p2) const { return mStart.sqrDist(p1) < mStart.sqrDist(p2); }
+
+private:
+  QgsPoint mStart;
+};
+
+PlanarGraph::PlanarGraph(double tolerance) : mSnapGrid(tolerance)
+{
+  mTolerance = tolerance;
+}
+
+int PlanarGraph::node(const QgsPoint& p)
+{
+  int n = mSnapGrid.snap(p);
+  if (n == mNodes.size())
+  {
+    GraphNode node;
+    node.point = p;
+    mNodes << node;
+  }
+  return n;
+}
+
+void PlanarGraph::addFeature(int node, int feature)
+{
+  if (!mNodes[node].features.contains(feature))
+    mNodes[node].features << feature;
+}
+
+void PlanarGraph::addEdge(int node1, int node2, int feature)
+{
+  GraphEdge edge;
+  edge.node1 = node1;
+  edge.node2 = node2;
+  edge.feature = feature;
+
+  mNodes[node1].edges << mEdges.size();
+  mNodes[node2].edges << mEdges.size();
+  mEdges << edge;
+
+  addFeature(node1, feature);
+  addFeature(node2, feature);
+}
+
+void PlanarGraph::build(FeatureStore& features, const TopolIndex* index)
+{
+  // node all lines at once, the segments of a feature follow each other
+  LineNoder noder;
+  QVector<int> firstSegment;
+  for (int i = 0; i < features.size(); ++i)
+  {
+    firstSegment << noder.segments().size();
+
+    QgsGeometry* g = features[i].feature.geometry();
+    QList<QgsPolyline> parts;
+    linearParts(g, parts);
+
+    for (int k = 0; k < parts.size(); ++k)
+      noder.addPolyline(parts[k], i, 0, k);
+  }
+  firstSegment << noder.segments().size();
+
+  const QVector<NodedSegment>& segments = noder.segments();
+  QVector<QVector<QgsPoint> > splits(segments.size());
+  QList<SegmentIntersection> intersections = noder.intersections();
+  QList<SegmentIntersection>::ConstIterator it = intersections.begin();
+  for (; it != intersections.end(); ++it)
+  {
+    splits[it->segment1] << it->point;
+    splits[it->segment2] << it->point;
+    if (it->overlap)
+    {
+      splits[it->segment1] << it->point2;
+      splits[it->segment2] << it->point2;
+    }
+  }
+
+  // part ends within the tolerance of another line split it there,
+  // the same vertex to segment distance the rules always used
+  double sqrTolerance = mTolerance * mTolerance;
+  if (mTolerance > 0 && index)
+  {
+    CandidateBuffer candidates;
+    for (int s = 0; s < segments.size(); ++s)
+    {
+      const NodedSegment& seg = segments[s];
+      for (int e = 0; e < 2; ++e)
+      {
+        if (!(e ? seg.last : seg.first))
+          continue;
+
+        const QgsPoint& p = e ? seg.p2 : seg.p1;
+        index->intersects(QgsRectangle(p.x() - mTolerance, p.y() - mTolerance, p.x() + mTolerance, p.y() + mTolerance), candidates);
+
+        for (int c = 0; c < candidates.size(); ++c)
+        {
+          // a feature joins itself only where it crosses itself
+          if (candidates[c] == seg.owner)
+            continue;
+
+          for (int t = firstSegment[candidates[c]]; t < firstSegment[candidates[c] + 1]; ++t)
+            if (sqrDistToSegment(p, segments[t].p1, segments[t].p2) <= sqrTolerance)
+              splits[t] << p;
+        }
+      }
+    }
+  }
+
+  // every part is walked from node to node, the pieces between them are the edges
+  int start = -1;
+  // the walk left the start node since the edge began, so that returning to it is a loop
+  bool moved = false;
+  for (int s = 0; s < segments.size(); ++s)
+  {
+    const NodedSegment& seg = segments[s];
+    if (seg.first)
+    {
+      start = node(seg.p1);
+      moved = false;
+      mFeatureEnds[seg.owner] << start;
+    }
+
+    QVector<QgsPoint>& points = splits[s];
+    std::sort(points.begin(), points.end(), DistanceLess(seg.p1));
+    if (seg.last)
+      points << seg.p2;
+
+    for (int j = 0; j < points.size(); ++j)
+    {
+      int n = node(points[j]);
+      if (n != start || moved)
+      {
+        addEdge(start, n, seg.owner);
+        start = n;
+        moved = false;
+      }
+    }
+
+    if (seg.last)
+      mFeatureEnds[seg.owner] << start;
+    else
+      moved = moved || mNodes[start].point.sqrDist(seg.p2) > sqrTolerance;
+
+    // the split points are not needed anymore
+    points = QVector<QgsPoint>();
+  }
+
+  mSnapGrid = SnapGrid(mTolerance);
+}
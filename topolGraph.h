@@ -0,0 +1,123 @@
+/***************************************************************************
+  topolGraph.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TOPOLGRAPH_H
+#define TOPOLGRAPH_H
+
+#include <QHash>
+#include <QVector>
+
+#include <qgsgeometry.h>
+#include <qgspoint.h>
+
+#include "featureStore.h"
+#include "snapGrid.h"
+#include "topolIndex.h"
+
+class GraphNode
+{
+public:
+  QgsPoint point;
+  // distinct features passing through the node (store indexes)
+  QVector<int> features;
+  // edges ending in the node, a loop is listed twice
+  QVector<int> edges;
+};
+
+class GraphEdge
+{
+public:
+  int node1;
+  int node2;
+  // store index of the feature the edge is part of
+  int feature;
+};
+
+/**
+ * Planar graph of a line layer. Nodes are the ends of the parts, all
+ * intersections and the points where a part ends within the tolerance
+ * of another line; vertices are snapped to one node within the tolerance.
+ * Edges are the pieces of the parts between the nodes. Built once per
+ * tolerance and shared by the dangle and pseudo-node rules.
+ */
+class PlanarGraph
+{
+public:
+  /**
+   * Constructor
+   * @param tolerance distance within which vertices are snapped to one node
+   *  and part ends join the lines passing by
+   */
+  PlanarGraph(double tolerance);
+
+  /**
+   * Builds the graph from all features of the store
+   * @param features features of the layer
+   * @param index spatial index of the features, finds the lines passing
+   *  near part ends; without it the ends join only lines they touch exactly
+   */
+  void build(FeatureStore& features, const TopolIndex* index);
+
+  double tolerance() const { return mTolerance; }
+  const QVector<GraphNode>& nodes() const { return mNodes; }
+  const QVector<GraphEdge>& edges() const { return mEdges; }
+
+  /**
+   * Returns nodes in which parts of the feature start or end
+   * @param feature store index of the feature
+   */
+  QVector<int> featureEnds(int feature) const { return mFeatureEnds.value(feature); }
+  /**
+   * Returns distinct features passing through the node
+   * @param node node index
+   */
+  QVector<int> nodeFeatures(int node) const { return mNodes[node].features; }
+  /**
+   * Returns number of edge ends in the node
+   * @param node node index
+   */
+  int degree(int node) const { return mNodes[node].edges.size(); }
+
+private:
+  double mTolerance;
+  QVector<GraphNode> mNodes;
+  QVector<GraphEdge> mEdges;
+  QHash<int, QVector<int> > mFeatureEnds;
+  // snaps vertices to nodes while building
+  SnapGrid mSnapGrid;
+
+  /**
+   * Returns node the point snaps to, a new one if there is none
+   * @param p point
+   */
+  int node(const QgsPoint& p);
+  /**
+   * Records that the feature passes through the node
+   * @param node node index
+   * @param feature store index of the feature
+   */
+  void addFeature(int node, int feature);
+  /**
+   * Appends edge of the feature between the nodes
+   * @param node1 start node
+   * @param node2 end node
+   * @param feature store index of the feature
+   */
+  void addEdge(int node1, int node2, int feature);
+};
+
+#endif
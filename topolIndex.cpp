@@ -0,0 +1,526 @@
+/***************************************************************************
+  topolIndex.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "topolIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+// maximal number of children of an R-tree node
+static const int sNodeCapacity = 16;
+// layers smaller than this are served well by any backend
+static const int sSmallLayer = 1000;
+// maximal number of grid cells per entry
+static const int sCellsPerEntry = 4;
+
+class CentreXLess
+{
+public:
+  bool operator()(const IndexBox& a, const IndexBox& b) const { return a.xCenter() < b.xCenter(); }
+};
+
+class CentreYLess
+{
+public:
+  bool operator()(const IndexBox& a, const IndexBox& b) const { return a.yCenter() < b.yCenter(); }
+};
+
+/**
+ * Sorts boxes into vertical slices by x and each slice by y,
+ * so that consecutive runs of capacity boxes form compact tiles
+ */
+template<class T> static void strSort(QVector<T>& boxes, int begin, int end, int capacity)
+{
+  int count = end - begin;
+  int tiles = (count + capacity - 1) / capacity;
+  int sliceSize = capacity * (int)ceil(sqrt((double)tiles));
+
+  std::sort(boxes.begin() + begin, boxes.begin() + end, CentreXLess());
+  for (int s = begin; s < end; s += sliceSize)
+    std::sort(boxes.begin() + s, boxes.begin() + qMin(s + sliceSize, end), CentreYLess());
+}
+
+LayerStatistics::LayerStatistics(QGis::GeometryType theGeometryType)
+{
+  geometryType = theGeometryType;
+  featureCount = 0;
+  sumWidth = 0;
+  sumHeight = 0;
+  sumArea = 0;
+  sumSqrArea = 0;
+}
+
+void LayerStatistics::addFeature(const QgsRectangle& bb)
+{
+  QgsRectangle r = bb;
+  if (featureCount)
+    extent.combineExtentWith(&r);
+  else
+    extent = r;
+
+  double area = bb.width() * bb.height();
+  ++featureCount;
+  sumWidth += bb.width();
+  sumHeight += bb.height();
+  sumArea += area;
+  sumSqrArea += area * area;
+}
+
+double LayerStatistics::areaVariation() const
+{
+  if (!featureCount || sumArea <= 0)
+    return 0;
+
+  double mean = sumArea / featureCount;
+  double variance = sumSqrArea / featureCount - mean * mean;
+  return sqrt(qMax(variance, 0.0)) / mean;
+}
+
+void TopolIndex::insert(int id, const QgsRectangle& bb)
+{
+  IndexEntry e;
+  e.id = id;
+  e.xMin = bb.xMinimum();
+  e.yMin = bb.yMinimum();
+  e.xMax = bb.xMaximum();
+  e.yMax = bb.yMaximum();
+  mEntries << e;
+}
+
+void TopolIndex::insertChunks(int id, const QgsPolyline& points, int chunkSize, int overlap)
+{
+  int begin = 0;
+  while (begin < points.size())
+  {
+    int end = qMin(begin + chunkSize + overlap, points.size());
+    QgsRectangle bb(points[begin].x(), points[begin].y(), points[begin].x(), points[begin].y());
+    for (int i = begin + 1; i < end; ++i)
+      bb.combineExtentWith(points[i].x(), points[i].y());
+    insert(id, bb);
+
+    // the last vertex of a run starts the next one when the runs overlap
+    if (end == points.size())
+      break;
+    begin = end - overlap;
+  }
+}
+
+void TopolIndex::insertParts(int id, QgsGeometry* g, int chunkSize)
+{
+  int count = mEntries.size();
+  QgsMultiPolyline lines;
+  QgsMultiPolygon polygons;
+
+  switch (g->wkbType())
+  {
+    case QGis::WKBMultiPoint:
+    case QGis::WKBMultiPoint25D:
+      insertChunks(id, g->asMultiPoint(), chunkSize, 0);
+    break;
+
+    case QGis::WKBLineString:
+    case QGis::WKBLineString25D:
+      insertChunks(id, g->asPolyline(), chunkSize, 1);
+    break;
+
+    case QGis::WKBMultiLineString:
+    case QGis::WKBMultiLineString25D:
+      lines = g->asMultiPolyline();
+      for (int i = 0; i < lines.size(); ++i)
+        insertChunks(id, lines[i], chunkSize, 1);
+    break;
+
+    // chunks of rings would miss the polygon interior, parts are the finest entries
+    case QGis::WKBMultiPolygon:
+    case QGis::WKBMultiPolygon25D:
+      polygons = g->asMultiPolygon();
+      for (int i = 0; i < polygons.size(); ++i)
+        if (!polygons[i].isEmpty())
+          insertChunks(id, polygons[i].first(), polygons[i].first().size(), 0);
+    break;
+
+    default:
+      insert(id, g->boundingBox());
+    break;
+  }
+
+  if (mEntries.size() - count > 1)
+    mSplit = true;
+}
+
+IndexType TopolIndex::chooseType(const LayerStatistics& stats)
+{
+  if (stats.geometryType == QGis::Point)
+    return IndexKdTree;
+
+  if (stats.featureCount < sSmallLayer)
+    return IndexRTree;
+
+  // many small features of similar size spread over the extent fit a uniform grid,
+  // anything else is left to the R-tree
+  double width = stats.extent.width();
+  double height = stats.extent.height();
+  bool smallFeatures = width > 0 && height > 0 &&
+    stats.meanWidth() < width / 100 && stats.meanHeight() < height / 100;
+
+  if (smallFeatures && stats.areaVariation() < 2)
+    return IndexGrid;
+
+  return IndexRTree;
+}
+
+TopolIndex* TopolIndex::create(IndexType type, const LayerStatistics& stats)
+{
+  if (type == IndexAuto)
+    type = chooseType(stats);
+
+  switch (type)
+  {
+    case IndexGrid:
+      return new GridIndex();
+    case IndexKdTree:
+      return new KdTreeIndex();
+    default:
+      return new RTreeIndex();
+  }
+}
+
+QStringList TopolIndex::typeNames()
+{
+  QStringList names;
+  names << "Automatic index" << "R-tree index" << "Grid index" << "K-d tree index";
+  return names;
+}
+
+IndexType TopolIndex::typeFromName(QString name)
+{
+  int type = typeNames().indexOf(name);
+  return type < 0 ? IndexAuto : (IndexType)type;
+}
+
+void RTreeIndex::build()
+{
+  mNodes.clear();
+  mLeafCount = 0;
+
+  if (mEntries.isEmpty())
+    return;
+
+  // leaves over tiles of entries
+  strSort(mEntries, 0, mEntries.size(), sNodeCapacity);
+  for (int i = 0; i < mEntries.size(); i += sNodeCapacity)
+  {
+    Node n;
+    n.first = i;
+    n.count = qMin(sNodeCapacity, mEntries.size() - i);
+    n.xMin = mEntries[i].xMin;
+    n.yMin = mEntries[i].yMin;
+    n.xMax = mEntries[i].xMax;
+    n.yMax = mEntries[i].yMax;
+    for (int j = i + 1; j < i + n.count; ++j)
+    {
+      n.xMin = qMin(n.xMin, mEntries[j].xMin);
+      n.yMin = qMin(n.yMin, mEntries[j].yMin);
+      n.xMax = qMax(n.xMax, mEntries[j].xMax);
+      n.yMax = qMax(n.yMax, mEntries[j].yMax);
+    }
+    mNodes << n;
+  }
+  mLeafCount = mNodes.size();
+
+  // upper levels until a single root is left, which is the last node
+  int levelBegin = 0;
+  int levelEnd = mNodes.size();
+  while (levelEnd - levelBegin > 1)
+  {
+    strSort(mNodes, levelBegin, levelEnd, sNodeCapacity);
+    for (int i = levelBegin; i < levelEnd; i += sNodeCapacity)
+    {
+      Node n;
+      n.first = i;
+      n.count = qMin(sNodeCapacity, levelEnd - i);
+      n.xMin = mNodes[i].xMin;
+      n.yMin = mNodes[i].yMin;
+      n.xMax = mNodes[i].xMax;
+      n.yMax = mNodes[i].yMax;
+      for (int j = i + 1; j < i + n.count; ++j)
+      {
+        n.xMin = qMin(n.xMin, mNodes[j].xMin);
+        n.yMin = qMin(n.yMin, mNodes[j].yMin);
+        n.xMax = qMax(n.xMax, mNodes[j].xMax);
+        n.yMax = qMax(n.yMax, mNodes[j].yMax);
+      }
+      mNodes << n;
+    }
+    levelBegin = levelEnd;
+    levelEnd = mNodes.size();
+  }
+}
+
+void RTreeIndex::query(const QgsRectangle& rect, IndexVisitor& visitor) const
+{
+  if (mNodes.isEmpty())
+    return;
+
+  QVector<int> stack;
+  stack << mNodes.size() - 1;
+  while (!stack.isEmpty())
+  {
+    const Node& n = mNodes[stack.last()];
+    bool leaf = stack.last() < mLeafCount;
+    stack.pop_back();
+
+    if (!n.intersects(rect))
+      continue;
+
+    for (int i = n.first; i < n.first + n.count; ++i)
+    {
+      if (leaf)
+      {
+        if (mEntries[i].intersects(rect))
+          visitor.visit(mEntries[i].id);
+      }
+      else
+        stack << i;
+    }
+  }
+}
+
+int GridIndex::column(double x) const
+{
+  return qBound(0, (int)floor((x - mXOrigin) / mCellSize), mColumns - 1);
+}
+
+int GridIndex::row(double y) const
+{
+  return qBound(0, (int)floor((y - mYOrigin) / mCellSize), mRows - 1);
+}
+
+void GridIndex::build()
+{
+  mCellStart.clear();
+  mCellEntries.clear();
+  mXOrigin = 0;
+  mYOrigin = 0;
+  mCellSize = 1;
+  mColumns = 1;
+  mRows = 1;
+
+  if (mEntries.isEmpty())
+    return;
+
+  LayerStatistics stats;
+  for (int i = 0; i < mEntries.size(); ++i)
+    stats.addFeature(QgsRectangle(mEntries[i].xMin, mEntries[i].yMin, mEntries[i].xMax, mEntries[i].yMax));
+
+  // cell about the size of an average feature, but not finer than
+  // the extent split evenly among the entries
+  double width = stats.extent.width();
+  double height = stats.extent.height();
+  mCellSize = qMax(qMax(stats.meanWidth(), stats.meanHeight()), sqrt(width * height / mEntries.size()));
+  if (mCellSize <= 0)
+    mCellSize = qMax(qMax(width, height), 1.0);
+
+  double maxCells = (double)sCellsPerEntry * mEntries.size();
+  while ((width / mCellSize + 1) * (height / mCellSize + 1) > maxCells)
+    mCellSize *= 2;
+
+  mXOrigin = stats.extent.xMinimum();
+  mYOrigin = stats.extent.yMinimum();
+  mColumns = (int)(width / mCellSize) + 1;
+  mRows = (int)(height / mCellSize) + 1;
+
+  // counting pass followed by filling pass into one flat array
+  mCellStart.fill(0, mColumns * mRows + 1);
+  for (int i = 0; i < mEntries.size(); ++i)
+  {
+    const IndexEntry& e = mEntries[i];
+    for (int r = row(e.yMin); r <= row(e.yMax); ++r)
+      for (int c = column(e.xMin); c <= column(e.xMax); ++c)
+        ++mCellStart[r * mColumns + c + 1];
+  }
+
+  for (int c = 1; c < mCellStart.size(); ++c)
+    mCellStart[c] += mCellStart[c-1];
+
+  QVector<int> fillPos = mCellStart;
+  mCellEntries.resize(mCellStart.last());
+  for (int i = 0; i < mEntries.size(); ++i)
+  {
+    const IndexEntry& e = mEntries[i];
+    for (int r = row(e.yMin); r <= row(e.yMax); ++r)
+      for (int c = column(e.xMin); c <= column(e.xMax); ++c)
+        mCellEntries[fillPos[r * mColumns + c]++] = i;
+  }
+}
+
+void GridIndex::query(const QgsRectangle& rect, IndexVisitor& visitor) const
+{
+  if (mEntries.isEmpty())
+    return;
+
+  int c1 = column(rect.xMinimum()), c2 = column(rect.xMaximum());
+  int r1 = row(rect.yMinimum()), r2 = row(rect.yMaximum());
+
+  for (int r = r1; r <= r2; ++r)
+    for (int c = c1; c <= c2; ++c)
+    {
+      int cell = r * mColumns + c;
+      for (int k = mCellStart[cell]; k < mCellStart[cell+1]; ++k)
+      {
+        const IndexEntry& e = mEntries[mCellEntries[k]];
+        if (!e.intersects(rect))
+          continue;
+
+        // report entries spanning several cells only once - in the cell
+        // holding the lower left corner of the entry and query overlap
+        if (column(qMax(e.xMin, rect.xMinimum())) != c || row(qMax(e.yMin, rect.yMinimum())) != r)
+          continue;
+
+        visitor.visit(e.id);
+      }
+    }
+}
+
+void KdTreeIndex::build()
+{
+  mHalfWidth = 0;
+  mHalfHeight = 0;
+  for (int i = 0; i < mEntries.size(); ++i)
+  {
+    mHalfWidth = qMax(mHalfWidth, (mEntries[i].xMax - mEntries[i].xMin) / 2);
+    mHalfHeight = qMax(mHalfHeight, (mEntries[i].yMax - mEntries[i].yMin) / 2);
+  }
+
+  build(0, mEntries.size(), 0);
+}
+
+void KdTreeIndex::build(int begin, int end, int depth)
+{
+  if (end - begin <= 1)
+    return;
+
+  // implicit tree: the median of the range is the node, halves are the subtrees
+  int mid = (begin + end) / 2;
+  if (depth % 2)
+    std::nth_element(mEntries.begin() + begin, mEntries.begin() + mid, mEntries.begin() + end, CentreYLess());
+  else
+    std::nth_element(mEntries.begin() + begin, mEntries.begin() + mid, mEntries.begin() + end, CentreXLess());
+
+  build(begin, mid, depth + 1);
+  build(mid + 1, end, depth + 1);
+}
+
+void KdTreeIndex::query(const QgsRectangle& rect, IndexVisitor& visitor) const
+{
+  // an entry can intersect the rectangle only if its centre lies in the grown rectangle
+  QgsRectangle centreRect(rect.xMinimum() - mHalfWidth, rect.yMinimum() - mHalfHeight,
+                          rect.xMaximum() + mHalfWidth, rect.yMaximum() + mHalfHeight);
+  query(0, mEntries.size(), 0, rect, centreRect, visitor);
+}
+
+void KdTreeIndex::query(int begin, int end, int depth, const QgsRectangle& rect, const QgsRectangle& centreRect, IndexVisitor& visitor) const
+{
+  if (begin >= end)
+    return;
+
+  int mid = (begin + end) / 2;
+  const IndexEntry& e = mEntries[mid];
+  double x = e.xCenter();
+  double y = e.yCenter();
+
+  if (centreRect.xMinimum() <= x && x <= centreRect.xMaximum() &&
+      centreRect.yMinimum() <= y && y <= centreRect.yMaximum() && e.intersects(rect))
+    visitor.visit(e.id);
+
+  double split = depth % 2 ? y : x;
+  double low = depth % 2 ? centreRect.yMinimum() : centreRect.xMinimum();
+  double high = depth % 2 ? centreRect.yMaximum() : centreRect.xMaximum();
+
+  if (low <= split)
+    query(begin, mid, depth + 1, rect, centreRect, visitor);
+  if (split <= high)
+    query(mid + 1, end, depth + 1, rect, centreRect, visitor);
+}
+
+// order points by one coordinate
+class PointXLess
+{
+public:
+  bool operator()(const PointEntry& a, const PointEntry& b) const { return a.x < b.x; }
+};
+
+class PointYLess
+{
+public:
+  bool operator()(const PointEntry& a, const PointEntry& b) const { return a.y < b.y; }
+};
+
+void PointTree::insert(int id, const QgsPoint& p)
+{
+  PointEntry e;
+  e.x = p.x();
+  e.y = p.y();
+  e.id = id;
+  mEntries << e;
+}
+
+void PointTree::build()
+{
+  build(0, mEntries.size(), 0);
+}
+
+void PointTree::build(int begin, int end, int depth)
+{
+  if (end - begin <= 1)
+    return;
+
+  // implicit tree like in KdTreeIndex
+  int mid = (begin + end) / 2;
+  if (depth % 2)
+    std::nth_element(mEntries.begin() + begin, mEntries.begin() + mid, mEntries.begin() + end, PointYLess());
+  else
+    std::nth_element(mEntries.begin() + begin, mEntries.begin() + mid, mEntries.begin() + end, PointXLess());
+
+  build(begin, mid, depth + 1);
+  build(mid + 1, end, depth + 1);
+}
+
+void PointTree::withinDistance(const QgsPoint& p, double distance, QVector<int>& ids) const
+{
+  withinDistance(0, mEntries.size(), 0, p, distance, ids);
+}
+
+void PointTree::withinDistance(int begin, int end, int depth, const QgsPoint& p, double distance, QVector<int>& ids) const
+{
+  if (begin >= end)
+    return;
+
+  int mid = (begin + end) / 2;
+  const PointEntry& e = mEntries[mid];
+  double dx = p.x() - e.x;
+  double dy = p.y() - e.y;
+
+  if (dx * dx + dy * dy < distance * distance)
+    ids << e.id;
+
+  double d = depth % 2 ? dy : dx;
+  if (d - distance <= 0)
+    withinDistance(begin, mid, depth + 1, p, distance, ids);
+  if (d + distance >= 0)
+    withinDistance(mid + 1, end, depth + 1, p, distance, ids);
+}
@@ -0,0 +1,326 @@
+/***************************************************************************
+  topolIndex.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef TOPOLINDEX_H
+#define TOPOLINDEX_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm>
+
+#include <qgis.h>
+#include <qgsgeometry.h>
+#include <qgspoint.h>
+#include <qgsrectangle.h>
+
+enum IndexType { IndexAuto, IndexRTree, IndexGrid, IndexKdTree };
+
+class IndexBox
+{
+public:
+  double xMin;
+  double yMin;
+  double xMax;
+  double yMax;
+
+  bool intersects(const QgsRectangle& r) const
+  {
+    return xMin <= r.xMaximum() && r.xMinimum() <= xMax && yMin <= r.yMaximum() && r.yMinimum() <= yMax;
+  }
+  double xCenter() const { return (xMin + xMax) / 2; }
+  double yCenter() const { return (yMin + yMax) / 2; }
+};
+
+class IndexEntry : public IndexBox
+{
+public:
+  int id;
+};
+
+/**
+ * Receives ids of entries found by an index query
+ */
+class IndexVisitor
+{
+public:
+  virtual ~IndexVisitor() {}
+  /**
+   * Called once for every entry matching the query
+   * @param id entry id
+   */
+  virtual void visit(int id) = 0;
+};
+
+/**
+ * Visitor collecting ids into a vector that keeps its capacity between queries,
+ * meant to be reused for all queries of a rule
+ */
+class CandidateBuffer : public IndexVisitor
+{
+public:
+  CandidateBuffer() { mIds.reserve(64); }
+
+  void visit(int id) { mIds << id; }
+  /**
+   * Forgets the ids, keeping the allocated space
+   */
+  void clear() { mIds.resize(0); }
+  /**
+   * Sorts the ids and removes repeated ones
+   */
+  void unique()
+  {
+    std::sort(mIds.begin(), mIds.end());
+    mIds.resize(std::unique(mIds.begin(), mIds.end()) - mIds.begin());
+  }
+  int size() const { return mIds.size(); }
+  int operator[](int i) const { return mIds[i]; }
+
+private:
+  QVector<int> mIds;
+};
+
+/**
+ * Summary of feature bounding boxes used to pick a suitable index backend
+ */
+class LayerStatistics
+{
+public:
+  LayerStatistics(QGis::GeometryType theGeometryType = QGis::UnknownGeometry);
+
+  /**
+   * Adds a feature bounding box to the statistics
+   * @param bb bounding box of the feature
+   */
+  void addFeature(const QgsRectangle& bb);
+
+  double meanWidth() const { return featureCount ? sumWidth / featureCount : 0; }
+  double meanHeight() const { return featureCount ? sumHeight / featureCount : 0; }
+  /**
+   * Returns coefficient of variation of the bounding box areas
+   */
+  double areaVariation() const;
+
+  QGis::GeometryType geometryType;
+  int featureCount;
+  QgsRectangle extent;
+  double sumWidth;
+  double sumHeight;
+  double sumArea;
+  double sumSqrArea;
+};
+
+/**
+ * Spatial index over feature bounding boxes
+ * Entries are collected with insert() and the structure is bulk loaded by build().
+ */
+class TopolIndex
+{
+public:
+  TopolIndex() { mSplit = false; }
+  virtual ~TopolIndex() {}
+
+  /**
+   * Adds an entry, must be called before build()
+   * @param id entry id
+   * @param bb bounding box of the feature
+   */
+  void insert(int id, const QgsRectangle& bb);
+  /**
+   * Adds entries for parts of a large geometry instead of one for its whole bounding box:
+   * one per polygon and one per run of at most chunkSize vertices of lines and multipoints.
+   * Queries then return the id once, however many of its entries match.
+   * @param id entry id shared by all the entries
+   * @param g geometry
+   * @param chunkSize maximum number of vertices per line or multipoint entry
+   */
+  void insertParts(int id, QgsGeometry* g, int chunkSize = 256);
+  /**
+   * Builds the index from the inserted entries
+   */
+  virtual void build() = 0;
+  /**
+   * Passes ids of entries whose bounding box intersects the rectangle to the visitor
+   * @param rect query rectangle
+   * @param visitor receiver of the ids
+   */
+  virtual void query(const QgsRectangle& rect, IndexVisitor& visitor) const = 0;
+  /**
+   * Fills the buffer with ids of entries whose bounding box intersects the rectangle
+   * @param rect query rectangle
+   * @param buffer reused buffer, cleared first
+   */
+  void intersects(const QgsRectangle& rect, CandidateBuffer& buffer) const
+  {
+    buffer.clear();
+    query(rect, buffer);
+
+    // geometries indexed by parts may match more than once
+    if (mSplit)
+      buffer.unique();
+  }
+  /**
+   * Returns the backend type
+   */
+  virtual IndexType type() const = 0;
+
+  /**
+   * Creates an empty index of the given type
+   * @param type backend type, IndexAuto is resolved from the statistics
+   * @param stats statistics of the indexed layer
+   */
+  static TopolIndex* create(IndexType type, const LayerStatistics& stats);
+  /**
+   * Picks the backend expected to be fastest for the layer
+   * @param stats statistics of the indexed layer
+   */
+  static IndexType chooseType(const LayerStatistics& stats);
+  /**
+   * Returns user visible names of index types, ordered by the IndexType values
+   */
+  static QStringList typeNames();
+  /**
+   * Returns index type of the user visible name, IndexAuto when unknown
+   * @param name type name
+   */
+  static IndexType typeFromName(QString name);
+
+protected:
+  QVector<IndexEntry> mEntries;
+  // some ids have more than one entry
+  bool mSplit;
+
+  /**
+   * Adds entries covering runs of at most chunkSize vertices
+   * @param id entry id
+   * @param points vertices
+   * @param chunkSize vertices per entry
+   * @param overlap 1 if neighbouring runs share a vertex, as segments of lines do
+   */
+  void insertChunks(int id, const QgsPolyline& points, int chunkSize, int overlap);
+};
+
+/**
+ * R-tree packed bottom-up with the sort-tile-recursive algorithm
+ */
+class RTreeIndex : public TopolIndex
+{
+public:
+  void build();
+  void query(const QgsRectangle& rect, IndexVisitor& visitor) const;
+  IndexType type() const { return IndexRTree; }
+
+private:
+  class Node : public IndexBox
+  {
+  public:
+    // children are nodes of the level below or entries for leaves
+    int first;
+    int count;
+  };
+
+  QVector<Node> mNodes;
+  int mLeafCount;
+};
+
+/**
+ * Uniform grid with cells sized after the average feature
+ */
+class GridIndex : public TopolIndex
+{
+public:
+  void build();
+  void query(const QgsRectangle& rect, IndexVisitor& visitor) const;
+  IndexType type() const { return IndexGrid; }
+
+private:
+  double mXOrigin;
+  double mYOrigin;
+  double mCellSize;
+  int mColumns;
+  int mRows;
+  // entries of cell c are mCellEntries[mCellStart[c] .. mCellStart[c+1])
+  QVector<int> mCellStart;
+  QVector<int> mCellEntries;
+
+  int column(double x) const;
+  int row(double y) const;
+};
+
+/**
+ * Static 2-d tree over bounding box centres, meant for point layers
+ */
+class KdTreeIndex : public TopolIndex
+{
+public:
+  void build();
+  void query(const QgsRectangle& rect, IndexVisitor& visitor) const;
+  IndexType type() const { return IndexKdTree; }
+
+private:
+  // largest half extents of the entries, queries are grown by them
+  double mHalfWidth;
+  double mHalfHeight;
+
+  void build(int begin, int end, int depth);
+  void query(int begin, int end, int depth, const QgsRectangle& rect, const QgsRectangle& centreRect, IndexVisitor& visitor) const;
+};
+
+class PointEntry
+{
+public:
+  double x;
+  double y;
+  int id;
+};
+
+/**
+ * Static k-d tree over point coordinates answering fixed radius queries,
+ * for point layers where bounding boxes and geometries are not needed
+ */
+class PointTree
+{
+public:
+  /**
+   * Adds a point, must be called before build()
+   * @param id entry id
+   * @param p point
+   */
+  void insert(int id, const QgsPoint& p);
+  /**
+   * Builds the tree from the inserted points
+   */
+  void build();
+  /**
+   * Appends ids of points closer to p than the distance
+   * @param p query point
+   * @param distance query radius
+   * @param ids vector to be filled
+   */
+  void withinDistance(const QgsPoint& p, double distance, QVector<int>& ids) const;
+
+private:
+  QVector<PointEntry> mEntries;
+
+  void build(int begin, int end, int depth);
+  void withinDistance(int begin, int end, int depth, const QgsPoint& p, double distance, QVector<int>& ids) const;
+};
+
+#endif
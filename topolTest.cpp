@@ -17,122 +17,170 @@
 
 #include "topolTest.h"
 
+#include <QFuture>
+#include <QMutexLocker>
+#include <QSet>
+#include <QThread>
+#include <QTime>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <qgscoordinatetransform.h>
 #include <qgsvectorlayer.h>
 #include <qgsmaplayer.h>
 #include <qgsmapcanvas.h>
 #include <qgsgeometry.h>
 #include <qgsfeature.h>
-#include <spatialindex/qgsspatialindex.h>
 
-#include "geosFunctions.h"
-#include "../../app/qgisapp.h"
+#include "errorArena.h"
+#include "featureQueue.h"
+#include "featureSample.h"
+#include "geometryHash.h"
+#include "geometryKernels.h"
+#include "geosContext.h"
+#include "lineNoder.h"
+#include "nativeFunctions.h"
+#include "preparedPolygon.h"
+#include "workScheduler.h"
 
 topolTest::topolTest()
 {
-  mTestCancelled = false;
+  mWarmUp = 0;
 
   // one layer tests
   mTestMap["Test geometry validity"].f = &topolTest::checkValid;
   mTestMap["Test geometry validity"].useSecondLayer = false;
+  mTestMap["Test geometry validity"].perFeature = true;
 
   mTestMap["Test segment lengths"].f = &topolTest::checkSegmentLength;
   mTestMap["Test segment lengths"].useTolerance = true;
   mTestMap["Test segment lengths"].useSecondLayer = false;
+  mTestMap["Test segment lengths"].perFeature = true;
 
   mTestMap["Test dangling lines"].f = &topolTest::checkDanglingLines;
+  mTestMap["Test dangling lines"].useTolerance = true;
   mTestMap["Test dangling lines"].useSecondLayer = false;
+  mTestMap["Test dangling lines"].wholeLayer = true;
+
+  mTestMap["Test pseudo-nodes"].f = &topolTest::checkPseudoNodes;
+  mTestMap["Test pseudo-nodes"].useTolerance = true;
+  mTestMap["Test pseudo-nodes"].useSecondLayer = false;
+  mTestMap["Test pseudo-nodes"].wholeLayer = true;
+
+  mTestMap["Test overlaps"].f = &topolTest::checkOverlaps;
+  mTestMap["Test overlaps"].useSecondLayer = false;
+  mTestMap["Test overlaps"].wholeLayer = true;
+
+  mTestMap["Test gaps"].f = &topolTest::checkGaps;
+  mTestMap["Test gaps"].useTolerance = true;
+  mTestMap["Test gaps"].useSecondLayer = false;
+  mTestMap["Test gaps"].wholeLayer = true;
+
+  mTestMap["Test duplicate geometries"].f = &topolTest::checkDuplicates;
+  mTestMap["Test duplicate geometries"].useTolerance = true;
+  mTestMap["Test duplicate geometries"].useSecondLayer = false;
+  mTestMap["Test duplicate geometries"].wholeLayer = true;
 
   // two layer tests
   mTestMap["Test intersections"].f = &topolTest::checkIntersections;
+  mTestMap["Test intersections"].join = JoinIntersects;
+  mTestMap["Test intersections"].perFeature = true;
   mTestMap["Test features inside polygon"].f = &topolTest::checkPolygonContains;
+  mTestMap["Test features inside polygon"].join = JoinContains;
+  mTestMap["Test features inside polygon"].perFeature = true;
+  // points exactly on a segment, rules saved before kept their tolerance ignored
   mTestMap["Test points not covered by segments"].f = &topolTest::checkPointCoveredBySegment;
+  mTestMap["Test points not covered by segments"].perFeature = true;
+  mTestMap["Test points farther than tolerance from segments"].f = &topolTest::checkPointCoveredBySegment;
+  mTestMap["Test points farther than tolerance from segments"].useTolerance = true;
+  mTestMap["Test points farther than tolerance from segments"].perFeature = true;
+  mTestMap["Test points inside polygons"].f = &topolTest::checkPointInPolygon;
   mTestMap["Test feature too close"].f = &topolTest::checkCloseFeature;
   mTestMap["Test feature too close"].useTolerance = true;
+  mTestMap["Test feature too close"].join = JoinClose;
+  mTestMap["Test feature too close"].perFeature = true;
 }
 
 topolTest::~topolTest()
 {
-  QMap<QString, QgsSpatialIndex*>::Iterator lit = mLayerIndexes.begin();
-  for (; lit != mLayerIndexes.end(); ++lit)
-    delete *lit;
-}
-
-void topolTest::setTestCancelled()
-{
-  mTestCancelled = true;
+  stopWarmUp();
 }
 
-bool topolTest::testCancelled()
+/**
+ * Returns true if the layer holds single points only
+ */
+static bool isPointLayer(QgsVectorLayer* layer)
 {
-  if (mTestCancelled)
-  {
-    mTestCancelled = false;
-    return true;
-  }
-
-  return false;
+  return layer->wkbType() == QGis::WKBPoint || layer->wkbType() == QGis::WKBPoint25D;
 }
 
-ErrorList topolTest::checkCloseFeature(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+ErrorList topolTest::checkCloseFeature(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
   ErrorList errorList;
   QString secondLayerId = layer2->getLayerID();
-  QgsSpatialIndex* index = mLayerIndexes[secondLayerId];
+  LayerData* data2 = run->layerData(secondLayerId);
+  TopolIndex* index = data2 ? data2->index : 0;
   if (!index)
   {
     std::cout << "No index for layer " << secondLayerId.toStdString() << "!\n";
     return errorList;
   }
 
+  // point layers are checked from coordinates only
+  if (isPointLayer(layer1) && isPointLayer(layer2))
+    return checkClosePoints(run, tolerance, layer1, layer2);
+
   bool badG1 = false, badG2 = false;
   bool skipItself = layer1 == layer2;
+  FeatureStore& features2 = data2->features;
+  CandidateBuffer crossingIds;
+  PairKernel kernel(layer1->geometryType(), layer2->geometryType());
 
   int i = 0;
   QList<FeatureLayer>::Iterator it;
-  QList<FeatureLayer>::ConstIterator FeatureListEnd = mFeatureList1.end();
-  for (it = mFeatureList1.begin(); it != FeatureListEnd; ++it)
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
+  for (it = run->features().begin(); it != FeatureListEnd; ++it)
   {
     if (!(++i % 100))
-      emit progress(i);
+      run->setProgress(i);
 
-    if (testCancelled())
+    if (run->isStopped())
       break;
 
+    // the kernels read native coordinates, the geometries are not exported to GEOS here
     QgsGeometry* g1 = it->feature.geometry();
+    if (!g1 || g1->wkbType() == QGis::WKBUnknown)
+    {
+      badG1 = true;
+      continue;
+    }
+
     QgsRectangle bb = g1->boundingBox();
 
     // increase bounding box by tolerance
     QgsRectangle frame(bb.xMinimum() - tolerance, bb.yMinimum() - tolerance, bb.xMaximum() + tolerance, bb.yMaximum() + tolerance); 
 
-    QList<int> crossingIds;
-    crossingIds = index->intersects(frame);
-    int crossSize = crossingIds.size();
-    
-    QList<int>::Iterator cit = crossingIds.begin();
-    QList<int>::ConstIterator crossingIdsEnd = crossingIds.end();
+    index->intersects(frame, crossingIds);
 
-    for (; cit != crossingIdsEnd; ++cit)
+    for (int c = 0; c < crossingIds.size(); ++c)
     {
-      QgsFeature& f = mFeatureMap2[*cit].feature;
+      QgsFeature& f = features2[crossingIds[c]].feature;
       QgsGeometry* g2 = f.geometry();
 
       // skip itself, when invoked with the same layer
       if (skipItself && f.id() == it->feature.id())
         continue;
 
-      if (!g2 || !g2->asGeos())
+      if (!g2 || g2->wkbType() == QGis::WKBUnknown)
       {
 	badG2 = true;
         continue;
       }
 
-      if (!g1 || !g1->asGeos())
-      {
-	badG1 = true;
-        continue;
-      }
-
-      if (g1->distance(*g2) < tolerance)
+      if (kernel.withinDistance(g1, g2, tolerance, run->geos()))
       {
         QgsRectangle r = g2->boundingBox();
 	r.combineExtentWith(&bb);
@@ -143,140 +191,617 @@ ErrorList topolTest::checkCloseFeature(double tolerance, QgsVectorLayer* layer1,
 	fl.layer = layer2;
 	fls << *it << fl;
 	QgsGeometry* conflict = new QgsGeometry(*g2);
-	TopolErrorClose* err = new TopolErrorClose(r, conflict, fls);
+	TopolErrorClose* err = run->arena()->create<TopolErrorClose>(r, conflict, fls);
 	//TopolErrorClose* err = new TopolErrorClose(r, g2, fls);
 
-	errorList << err;
+	run->addError(errorList, err);
       }
     }
   }
 
   if (badG2)
-    std::cout << "g2 or g2->asGeos() == NULL in close\n" << std::flush;
+    std::cout << "g2 without geometry in close\n" << std::flush;
 
   if (badG1)
-    std::cout << "g1 or g1->asGeos() == NULL in close\n" << std::flush;
+    std::cout << "g1 without geometry in close\n" << std::flush;
 
   return errorList;
 }
 
-ErrorList topolTest::checkDanglingLines(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+QList<QPair<int, int> > topolTest::closePointChunk(const TestRun* run, const PointTree* tree, const QVector<QgsPoint>* points, int begin, int end)
+{
+  QList<QPair<int, int> > pairs;
+  QVector<int> ids;
+
+  for (int i = begin; i < end && !run->isStopped(); ++i)
+  {
+    ids.resize(0);
+    tree->withinDistance((*points)[i], run->tolerance(), ids);
+    for (int j = 0; j < ids.size(); ++j)
+      pairs << qMakePair(i, ids[j]);
+  }
+
+  return pairs;
+}
+
+ErrorList topolTest::checkClosePoints(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
-  //TODO: multilines - check all separate pieces
-  int i = 0;
   ErrorList errorList;
-  QString layerId = layer1->getLayerID();
-  QgsSpatialIndex* index = mLayerIndexes[layerId];
-  if (!index)
+  bool skipItself = layer1 == layer2;
+  FeatureStore& features2 = run->layerData(layer2->getLayerID())->features;
+
+  PointTree tree;
+  for (int j = 0; j < features2.size(); ++j)
+    tree.insert(j, features2[j].feature.geometry()->asPoint());
+  tree.build();
+
+  QVector<QgsPoint> points(run->features().size());
+  for (int i = 0; i < run->features().size(); ++i)
+    points[i] = run->features()[i].feature.geometry()->asPoint();
+
+  int chunkSize = points.size() / (4 * QThread::idealThreadCount()) + 1;
+
+  QList<QFuture<QList<QPair<int, int> > > > chunks;
+  for (int begin = 0; begin < points.size(); begin += chunkSize)
+    chunks << QtConcurrent::run(this, &topolTest::closePointChunk, (const TestRun*) run, (const PointTree*) &tree, (const QVector<QgsPoint>*) &points, begin, qMin(begin + chunkSize, points.size()));
+
+  // all chunks are waited for, they refer to the tree and the points
+  for (int c = 0; c < chunks.size(); ++c)
   {
-    // attempt to create new index - it was not built in runtest()
-    mLayerIndexes[layerId] = createIndex(layer1);
-    index = mLayerIndexes[layerId];
+    QList<QPair<int, int> > pairs = chunks[c].result();
+    run->setProgress(qMin((c + 1) * chunkSize, points.size()));
 
-    if (!index)
+    if (run->isStopped())
+      continue;
+
+    for (int p = 0; p < pairs.size(); ++p)
     {
-      std::cout << "No index for layer " << layerId.toStdString() << "!\n";
-      return errorList;
+      FeatureLayer& fl1 = run->features()[pairs[p].first];
+      FeatureLayer& fl2 = features2[pairs[p].second];
+
+      // skip itself, when invoked with the same layer
+      if (skipItself && fl1.feature.id() == fl2.feature.id())
+        continue;
+
+      const QgsPoint& p1 = points[pairs[p].first];
+      QgsPoint p2 = fl2.feature.geometry()->asPoint();
+      QgsRectangle r(qMin(p1.x(), p2.x()), qMin(p1.y(), p2.y()), qMax(p1.x(), p2.x()), qMax(p1.y(), p2.y()));
+
+      QList<FeatureLayer> fls;
+      fls << fl1 << fl2;
+      QgsGeometry* conflict = new QgsGeometry(*fl2.feature.geometry());
+      TopolErrorClose* err = run->arena()->create<TopolErrorClose>(r, conflict, fls);
+
+      run->addError(errorList, err);
     }
   }
-  else // map was not filled in runtest()
-    fillFeatureMap(layer1);
-  
+
+  return errorList;
+}
+
+ErrorList topolTest::checkDanglingLines(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+{
+  int i = 0;
+  ErrorList errorList;
+
   if (layer1->geometryType() != QGis::Line)
     return errorList;
 
+  PlanarGraph* graph = layerGraph(run, layer1, tolerance);
+  if (!graph)
+  {
+    std::cout << "No graph for layer " << layer1->getLayerID().toStdString() << "!\n";
+    return errorList;
+  }
+
+  FeatureStore& features = run->layerData(layer1->getLayerID())->features;
+
   QList<FeatureLayer>::Iterator it;
-  QList<FeatureLayer>::ConstIterator FeatureListEnd = mFeatureList1.end();
-  for (it = mFeatureList1.begin(); it != FeatureListEnd; ++it)
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
+  for (it = run->features().begin(); it != FeatureListEnd; ++it)
   {
     if (!(++i % 100))
-      emit progress(i);
+      run->setProgress(i);
 
-    if (testCancelled())
+    if (run->isStopped())
       break;
 
-    QgsGeometry* g1 = it->feature.geometry();
-    QgsRectangle bb = g1->boundingBox();
-
-    QList<int> crossingIds;
-    crossingIds = index->intersects(bb);
-    int crossSize = crossingIds.size();
-    
-    QList<int>::Iterator cit = crossingIds.begin();
-    QList<int>::ConstIterator crossingIdsEnd = crossingIds.end();
-
-    // QList for multilines
-    // QList<QgsPoint> endPoints;
-    // QGis::WkbType type = g1->wkbType();
-    // if (type == WKBMultiLineString || type == WKBMultiLineString25D)
-    //   for (...)
-    // else
-    QgsGeometry* startPoint = QgsGeometry::fromPoint(g1->asPolyline().first());
-    QgsGeometry* endPoint = QgsGeometry::fromPoint(g1->asPolyline().last());
-    if (!startPoint || !endPoint)
+    int feature = features.indexOf(it->feature.id());
+    if (feature < 0)
       continue;
 
+    // connected when any start or end of its parts is shared with another feature,
+    // including ends lying on other lines or within the tolerance of them
     bool touches = false;
-    for (; cit != crossingIdsEnd; ++cit)
+    QVector<int> ends = graph->featureEnds(feature);
+    for (int e = 0; e < ends.size() && !touches; ++e)
+      touches = graph->nodeFeatures(ends[e]).size() > 1;
+
+    if (!touches)
     {
-      // skip itself
-      if (mFeatureMap2[*cit].feature.id() == it->feature.id())
-	continue;
+      QgsGeometry* g1 = it->feature.geometry();
+      QList<FeatureLayer> fls;
+      fls << *it << *it;
+      QgsGeometry* conflict = new QgsGeometry(*g1);
+      TopolErrorDangle* err = run->arena()->create<TopolErrorDangle>(g1->boundingBox(), conflict, fls);
 
-      QgsGeometry* g2 = mFeatureMap2[*cit].feature.geometry();
-      if (!g2)
-      {
-	std::cout << "g2 == NULL in dangling line test\n" << std::flush;
-        continue;
-      }
+      run->addError(errorList, err);
+    }
+  }
 
-      if (!g2->asGeos())
-      {
-	std::cout << "g2->asGeos() == NULL in dangling line test\n" << std::flush;
+  return errorList;
+}
+
+/**
+ * Returns store indexes of the features being checked
+ */
+static QSet<int> checkedFeatures(FeatureStore& features, const QList<FeatureLayer>& featureList)
+{
+  QSet<int> result;
+  for (int i = 0; i < featureList.size(); ++i)
+  {
+    int feature = features.indexOf(featureList[i].feature.id());
+    if (feature >= 0)
+      result << feature;
+  }
+  return result;
+}
+
+ErrorList topolTest::checkPseudoNodes(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+{
+  ErrorList errorList;
+
+  if (layer1->geometryType() != QGis::Line)
+    return errorList;
+
+  PlanarGraph* graph = layerGraph(run, layer1, tolerance);
+  if (!graph)
+  {
+    std::cout << "No graph for layer " << layer1->getLayerID().toStdString() << "!\n";
+    return errorList;
+  }
+
+  FeatureStore& features = run->layerData(layer1->getLayerID())->features;
+  QSet<int> checked = checkedFeatures(features, run->features());
+  const QVector<GraphNode>& nodes = graph->nodes();
+
+  for (int n = 0; n < nodes.size(); ++n)
+  {
+    if (!(n % 100))
+      run->setProgress(n);
+
+    if (run->isStopped())
+      break;
+
+    // two edges of two different lines end in the node; a line passing
+    // through it or a third one makes it a junction
+    if (graph->degree(n) != 2 || nodes[n].features.size() != 2)
+      continue;
+
+    int line1 = nodes[n].features[0];
+    int line2 = nodes[n].features[1];
+    if (!checked.contains(line1) && !checked.contains(line2))
+      continue;
+
+    QgsRectangle bb = features[line1].feature.geometry()->boundingBox();
+    QgsRectangle bb2 = features[line2].feature.geometry()->boundingBox();
+    bb.combineExtentWith(&bb2);
+
+    QList<FeatureLayer> fls;
+    fls << features[line1] << features[line2];
+    QgsGeometry* conflict = pointGeometry(nodes[n].point);
+    TopolErrorPseudo* err = run->arena()->create<TopolErrorPseudo>(bb, conflict, fls);
+
+    run->addError(errorList, err);
+  }
+
+  return errorList;
+}
+
+QList<QPair<int, int> > topolTest::overlapStrip(const TestRun* run, const EnvelopeJoin* join, const FeatureStore* features, int begin, int end)
+{
+  QList<QPair<int, int> > candidates;
+  QList<QPair<int, int> > overlaps;
+
+  // candidates are generated in small batches to keep the list short
+  for (int batch = begin; batch < end && !run->isStopped(); batch += 1024)
+  {
+    // the strip exports its own GEOS geometries, the global GEOS API is not thread-safe;
+    // those of one batch are kept at a time
+    GeosContext geos;
+
+    candidates.clear();
+    join->join(batch, qMin(batch + 1024, end), candidates);
+
+    for (int c = 0; c < candidates.size(); ++c)
+    {
+      int i1 = candidates[c].first;
+      int i2 = candidates[c].second;
+      const GEOSGeometry* g1 = geos.geometry(i1, (*features)[i1].feature.geometry());
+      const GEOSGeometry* g2 = geos.geometry(i2, (*features)[i2].feature.geometry());
+      if (!g1 || !g2)
         continue;
-      }
 
-      //if (touchesPoints(endPoints, g2))
-      // test both endpoints
-      if (geosTouches(startPoint, g2) || geosTouches(endPoint, g2))
-      {
-	touches = true;
-	break;
-      }
+      // interiors intersect when the polygons overlap or one contains the other
+      if (geos.overlaps(g1, g2) || geos.contains(g1, g2) || geos.contains(g2, g1))
+        overlaps << candidates[c];
     }
+  }
 
-    if (!touches)
+  return overlaps;
+}
+
+ErrorList topolTest::checkOverlaps(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+{
+  ErrorList errorList;
+
+  if (layer1->geometryType() != QGis::Polygon)
+    return errorList;
+
+  QString layerId = layer1->getLayerID();
+  LayerData* data = layerData(run, layer1);
+  if (!data)
+  {
+    std::cout << "No index for layer " << layerId.toStdString() << "!\n";
+    return errorList;
+  }
+
+  FeatureStore& features = data->features;
+  QSet<int> checked = checkedFeatures(features, run->features());
+
+  EnvelopeJoin join;
+  QVector<int> vertices(features.size());
+  for (int i = 0; i < features.size(); ++i)
+  {
+    QgsGeometry* g = features[i].feature.geometry();
+    join.add(i, g->boundingBox());
+    vertices[i] = vertexCount(g);
+  }
+  join.prepare();
+
+  // a candidate pair costs about the vertices of both polygons, it is tested
+  // by the strip holding its left box; the sweep counts the pairs without an index query
+  WorkScheduler scheduler;
+  QVector<double> costs = join.costs(vertices);
+  for (int k = 0; k < costs.size(); ++k)
+    scheduler.add(costs[k]);
+
+  QVector<WorkTask> tasks = scheduler.tasks(4 * QThread::idealThreadCount());
+
+  QList<QFuture<QList<QPair<int, int> > > > strips;
+  for (int t = 0; t < tasks.size(); ++t)
+    strips << QtConcurrent::run(this, &topolTest::overlapStrip, (const TestRun*) run, (const EnvelopeJoin*) &join, (const FeatureStore*) &features, tasks[t].begin, tasks[t].end);
+
+  // all strips are waited for, they refer to the join and the store
+  double done = 0;
+  for (int s = 0; s < strips.size(); ++s)
+  {
+    QList<QPair<int, int> > overlaps = strips[s].result();
+    done += tasks[s].cost;
+    run->setProgress(scheduler.progress(done, features.size()));
+
+    if (run->isStopped())
+      continue;
+
+    for (int o = 0; o < overlaps.size(); ++o)
     {
+      if (!checked.contains(overlaps[o].first) && !checked.contains(overlaps[o].second))
+        continue;
+
+      FeatureLayer& fl1 = features[overlaps[o].first];
+      FeatureLayer& fl2 = features[overlaps[o].second];
+
+      QgsRectangle bb = fl1.feature.geometry()->boundingBox();
+      QgsRectangle bb2 = fl2.feature.geometry()->boundingBox();
+      bb.combineExtentWith(&bb2);
+
+      // the overlapping area is computed when the error is shown
       QList<FeatureLayer> fls;
-      fls << *it << *it;
-      QgsGeometry* conflict = new QgsGeometry(*g1);
-      TopolErrorDangle* err = new TopolErrorDangle(bb, conflict, fls);
+      fls << fl1 << fl2;
+      TopolErrorOverlap* err = run->arena()->create<TopolErrorOverlap>(bb, 0, fls);
+
+      run->addError(errorList, err);
+    }
+  }
+
+  return errorList;
+}
+
+TileGaps topolTest::gapTile(const TestRun* run, const TopolIndex* index, const FeatureStore* features, QgsRectangle tile)
+{
+  TileGaps result;
+  if (run->isStopped())
+    return result;
+
+  // only polygons reaching into the tile can cover it
+  CandidateBuffer candidates;
+  index->intersects(tile, candidates);
+
+  // the tile exports its own GEOS geometries, the global GEOS API is not thread-safe
+  GeosContext geos;
+  QList<const GEOSGeometry*> polygons;
+  for (int c = 0; c < candidates.size(); ++c)
+  {
+    const GEOSGeometry* g = geos.geometry(candidates[c], (*features)[candidates[c]].feature.geometry());
+    if (g)
+      polygons << g;
+  }
+
+  GEOSGeometry* tileGeometry = geos.rectangle(tile);
+  GEOSGeometry* coverage = geos.cascadedUnion(polygons);
+  GEOSGeometry* uncovered = coverage ? geos.difference(tileGeometry, coverage) : tileGeometry;
+  if (uncovered != tileGeometry)
+    geos.destroy(tileGeometry);
+  geos.destroy(coverage);
+
+  if (!uncovered)
+  {
+    std::cout << "Difference failed in gap test\n" << std::flush;
+    return result;
+  }
+
+  // the pieces are built from WKB, the rule thread stitches them later
+  QList<QgsGeometry*> parts;
+  geos.polygonParts(uncovered, parts);
+  geos.destroy(uncovered);
+
+  for (int i = 0; i < parts.size(); ++i)
+  {
+    QgsRectangle bb = parts[i]->boundingBox();
+    if (bb.xMinimum() > tile.xMinimum() && bb.xMaximum() < tile.xMaximum() &&
+        bb.yMinimum() > tile.yMinimum() && bb.yMaximum() < tile.yMaximum())
+      result.gaps << parts[i];
+    else
+      result.border << parts[i];
+  }
+
+  return result;
+}
+
+ErrorList topolTest::checkGaps(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+{
+  ErrorList errorList;
+
+  if (layer1->geometryType() != QGis::Polygon)
+    return errorList;
 
-      errorList << err;
+  QString layerId = layer1->getLayerID();
+  LayerData* data = layerData(run, layer1);
+  if (!data)
+  {
+    std::cout << "No index for layer " << layerId.toStdString() << "!\n";
+    return errorList;
+  }
+
+  TopolIndex* index = data->index;
+  FeatureStore& features = data->features;
+  QSet<int> checked = checkedFeatures(features, run->features());
+  if (!features.size())
+    return errorList;
+
+  QgsRectangle extent = features[0].feature.geometry()->boundingBox();
+  for (int i = 0; i < features.size(); ++i)
+  {
+    QgsGeometry* g = features[i].feature.geometry();
+    QgsRectangle bb = g->boundingBox();
+    extent.combineExtentWith(&bb);
+  }
+
+  // about 256 polygons per tile
+  int side = qMax(1, (int) ceil(sqrt(features.size() / 256.0)));
+  double width = extent.width() / side;
+  double height = extent.height() / side;
+
+  QVector<QgsRectangle> tileRects;
+  for (int y = 0; y < side; ++y)
+    for (int x = 0; x < side; ++x)
+    {
+      // the last tiles end exactly on the extent so that pieces outside the coverage touch it
+      tileRects << QgsRectangle(extent.xMinimum() + x * width, extent.yMinimum() + y * height,
+                                x + 1 == side ? extent.xMaximum() : extent.xMinimum() + (x + 1) * width,
+                                y + 1 == side ? extent.yMaximum() : extent.yMinimum() + (y + 1) * height);
     }
 
-    delete startPoint, endPoint;
+  // a tile costs about the vertices of the polygons reaching into it, the most expensive start first
+  WorkScheduler scheduler;
+  CandidateBuffer candidates;
+  QList<QPair<double, int> > order;
+  for (int t = 0; t < tileRects.size(); ++t)
+  {
+    index->intersects(tileRects[t], candidates);
+
+    double cost = 1;
+    for (int c = 0; c < candidates.size(); ++c)
+      cost += vertexCount(features[candidates[c]].feature.geometry());
+    scheduler.add(cost);
+    order << qMakePair(-cost, t);
+  }
+  std::sort(order.begin(), order.end());
+
+  QList<QFuture<TileGaps> > tiles;
+  for (int t = 0; t < order.size(); ++t)
+    tiles << QtConcurrent::run(this, &topolTest::gapTile, (const TestRun*) run, (const TopolIndex*) index, (const FeatureStore*) &features, tileRects[order[t].second]);
+
+  QList<QgsGeometry*> gaps;
+  QList<QgsGeometry*> border;
+  double done = 0;
+  for (int t = 0; t < tiles.size(); ++t)
+  {
+    TileGaps result = tiles[t].result();
+    gaps << result.gaps;
+    border << result.border;
+    done -= order[t].first;
+    run->setProgress(scheduler.progress(done, features.size()));
+  }
+
+  // uncovered pieces are joined across tile borders, those reaching
+  // the extent border lie outside of the coverage
+  if (!run->isStopped())
+  {
+    GeosContext* geos = run->geos();
+    QList<GEOSGeometry*> exported;
+    QList<const GEOSGeometry*> pieces;
+    for (int i = 0; i < border.size(); ++i)
+    {
+      GEOSGeometry* piece = geos->exportGeometry(border[i]);
+      if (!piece)
+        continue;
+
+      exported << piece;
+      pieces << piece;
+    }
+
+    GEOSGeometry* stitched = geos->cascadedUnion(pieces);
+    QList<QgsGeometry*> parts;
+    if (stitched)
+      geos->polygonParts(stitched, parts);
+    geos->destroy(stitched);
+    for (int i = 0; i < exported.size(); ++i)
+      geos->destroy(exported[i]);
+
+    for (int i = 0; i < parts.size(); ++i)
+    {
+      QgsRectangle bb = parts[i]->boundingBox();
+      if (bb.xMinimum() > extent.xMinimum() && bb.xMaximum() < extent.xMaximum() &&
+          bb.yMinimum() > extent.yMinimum() && bb.yMaximum() < extent.yMaximum())
+        gaps << parts[i];
+      else
+        delete parts[i];
+    }
+  }
+  qDeleteAll(border);
+
+  CandidateBuffer neighbourIds;
+  for (int i = 0; i < gaps.size(); ++i)
+  {
+    QgsGeometry* gap = gaps[i];
+    QgsPolygon polygon = gap->asPolygon();
+
+    double area = 0, perimeter = 0;
+    for (int r = 0; r < polygon.size(); ++r)
+    {
+      area += r ? -qAbs(ringArea(polygon[r])) / 2 : qAbs(ringArea(polygon[r])) / 2;
+      perimeter += lineLength(polygon[r]);
+    }
+
+    // slivers narrower than the tolerance on average are not reported
+    if (run->isStopped() || area <= 0 || 2 * area / perimeter < tolerance)
+    {
+      delete gap;
+      continue;
+    }
+
+    QgsRectangle bb = gap->boundingBox();
+    index->intersects(bb, neighbourIds);
+
+    bool report = false;
+    QList<FeatureLayer> fls;
+    for (int c = 0; c < neighbourIds.size(); ++c)
+    {
+      if (!run->geos()->intersects(features[neighbourIds[c]].feature.geometry(), gap))
+        continue;
+
+      report = report || checked.contains(neighbourIds[c]);
+      if (fls.size() < 2)
+        fls << features[neighbourIds[c]];
+    }
+
+    if (!report)
+    {
+      delete gap;
+      continue;
+    }
+
+    if (fls.size() < 2)
+      fls << fls.first();
+
+    TopolErrorGap* err = run->arena()->create<TopolErrorGap>(bb, gap, fls);
+    run->addError(errorList, err);
   }
 
   return errorList;
 }
 
-/*bool touchesPoints(QList<QgsPoint endPoints, QgsGeometry* g)
+ErrorList topolTest::checkDuplicates(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
+  ErrorList errorList;
+  QString layerId = layer1->getLayerID();
+  LayerData* data = layerData(run, layer1);
+  if (!data)
+  {
+    std::cout << "No index for layer " << layerId.toStdString() << "!\n";
+    return errorList;
+  }
+
+  FeatureStore& features = data->features;
+  QSet<int> checked = checkedFeatures(features, run->features());
+
+  // only hashes are kept, colliding geometries are normalized again to confirm
+  QHash<uint, QVector<int> > buckets;
+  buckets.reserve(features.size());
+  for (int i = 0; i < features.size(); ++i)
+  {
+    if (!(i % 100))
+      run->setProgress(i);
+
+    if (run->isStopped())
+      return errorList;
+
+    buckets[NormalizedGeometry(features[i].feature.geometry(), tolerance).hash()] << i;
+  }
+
+  QHash<uint, QVector<int> >::ConstIterator it = buckets.begin();
+  for (; it != buckets.end(); ++it)
+  {
+    const QVector<int>& bucket = *it;
+    if (bucket.size() < 2)
+      continue;
+
+    QList<NormalizedGeometry> normalized;
+    for (int b = 0; b < bucket.size(); ++b)
+      normalized << NormalizedGeometry(features[bucket[b]].feature.geometry(), tolerance);
+
+    // every duplicate is reported once, against the first feature of its group
+    QVector<bool> grouped(bucket.size(), false);
+    for (int a = 0; a < bucket.size(); ++a)
+    {
+      if (grouped[a])
+        continue;
+
+      for (int b = a + 1; b < bucket.size(); ++b)
+      {
+        if (grouped[b] || !(normalized[a] == normalized[b]))
+          continue;
+
+        grouped[b] = true;
+        if (!checked.contains(bucket[a]) && !checked.contains(bucket[b]))
+          continue;
+
+        QgsGeometry* g1 = features[bucket[a]].feature.geometry();
+        QList<FeatureLayer> fls;
+        fls << features[bucket[a]] << features[bucket[b]];
+        QgsGeometry* conflict = new QgsGeometry(*g1);
+        TopolErrorDuplicate* err = run->arena()->create<TopolErrorDuplicate>(g1->boundingBox(), conflict, fls);
+
+        run->addError(errorList, err);
+      }
+    }
+  }
+
+  return errorList;
 }
-*/
 
-ErrorList topolTest::checkValid(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+ErrorList topolTest::checkValid(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
   int i = 0;
   ErrorList errorList;
   QList<FeatureLayer>::Iterator it;
 
-  for (it = mFeatureList1.begin(); it != mFeatureList1.end(); ++it)
+  for (it = run->features().begin(); it != run->features().end(); ++it)
   {
     if (!(++i % 100))
-      emit progress(++i);
-    if (testCancelled())
+      run->setProgress(++i);
+    if (run->isStopped())
       break;
 
     QgsGeometry* g = it->feature.geometry();
@@ -286,30 +811,35 @@ ErrorList topolTest::checkValid(double tolerance, QgsVectorLayer* layer1, QgsVec
       continue;
     }
 
-    if (!g->asGeos())
+    GEOSGeometry* exported = run->geos()->exportGeometry(g);
+    if (!exported)
       continue;
 
-    if (!GEOSisValid(g->asGeos()))
+    bool valid = run->geos()->isValid(exported);
+    run->geos()->destroy(exported);
+
+    if (!valid)
     {
       QgsRectangle r = g->boundingBox();
       QList<FeatureLayer> fls;
       fls << *it << *it;
 
       QgsGeometry* conflict = new QgsGeometry(*g);
-      TopolErrorValid* err = new TopolErrorValid(r, conflict, fls);
-      errorList << err;
+      TopolErrorValid* err = run->arena()->create<TopolErrorValid>(r, conflict, fls);
+      run->addError(errorList, err);
     }
   }
 
   return errorList;
 }
 
-ErrorList topolTest::checkPolygonContains(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+ErrorList topolTest::checkPolygonContains(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
   int i = 0;
   ErrorList errorList;
   QString secondLayerId = layer2->getLayerID();
-  QgsSpatialIndex* index = mLayerIndexes[secondLayerId];
+  LayerData* data2 = run->layerData(secondLayerId);
+  TopolIndex* index = data2 ? data2->index : 0;
 
   bool skipItself = layer1 == layer2;
 
@@ -321,72 +851,176 @@ ErrorList topolTest::checkPolygonContains(double tolerance, QgsVectorLayer* laye
 
   if (layer1->geometryType() != QGis::Polygon)
     return errorList;
-  
+
+  FeatureStore& features2 = data2->features;
+  CandidateBuffer crossingIds;
+  GeosContext* geos = run->geos();
+
   QList<FeatureLayer>::Iterator it;
-  QList<FeatureLayer>::ConstIterator FeatureListEnd = mFeatureList1.end();
-  for (it = mFeatureList1.begin(); it != FeatureListEnd; ++it)
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
+  for (it = run->features().begin(); it != FeatureListEnd; ++it)
   {
     if (!(++i % 100))
-      emit progress(i);
+      run->setProgress(i);
+
+    if (run->isStopped())
+      break;
+
+    QgsGeometry* g1 = it->feature.geometry();
+    QgsRectangle bb = g1->boundingBox();
+
+    index->intersects(bb, crossingIds);
+    if (crossingIds.size() == 0)
+      continue;
+
+    GEOSGeometry* polygon = geos->exportGeometry(g1);
+    if (!polygon)
+      continue;
+
+    for (int c = 0; c < crossingIds.size(); ++c)
+    {
+      QgsFeature& f = features2[crossingIds[c]].feature;
+      QgsGeometry* g2 = f.geometry();
+
+      // skip itself, when invoked with the same layer
+      if (skipItself && f.id() == it->feature.id())
+        continue;
+
+      if (!g2)
+      {
+	std::cout << "g2 == NULL in contains\n" << std::flush;
+        continue;
+      }
+
+      // features of the second layer are exported once for the whole test
+      const GEOSGeometry* contained = geos->geometry(crossingIds[c], g2);
+      if (!contained)
+      {
+	std::cout << "g2 cannot be exported in contains\n" << std::flush;
+        continue;
+      }
+
+      if (geos->contains(polygon, contained))
+      {
+	QList<FeatureLayer> fls;
+	FeatureLayer fl;
+	fl.feature = f;
+	fl.layer = layer2;
+	fls << *it << fl;
+        QgsGeometry* conflict = new QgsGeometry(*g2);
+	TopolErrorInside* err = run->arena()->create<TopolErrorInside>(bb, conflict, fls);
+
+	run->addError(errorList, err);
+      }
+    }
+
+    geos->destroy(polygon);
+  }
+
+  geos->clear();
+  return errorList;
+}
+
+ErrorList topolTest::checkPointInPolygon(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+{
+  int i = 0;
+  ErrorList errorList;
+  QString secondLayerId = layer2->getLayerID();
+  LayerData* data2 = run->layerData(secondLayerId);
+  TopolIndex* index = data2 ? data2->index : 0;
+
+  if (!index)
+  {
+    std::cout << "No index for layer " << secondLayerId.toStdString() << "!\n";
+    return errorList;
+  }
 
-    if (testCancelled())
-      break;
+  if (layer1->geometryType() != QGis::Point)
+    return errorList;
+  if (layer2->geometryType() != QGis::Polygon)
+    return errorList;
 
-    QgsGeometry* g1 = it->feature.geometry();
-    QgsRectangle bb = g1->boundingBox();
+  FeatureStore& features2 = data2->features;
+  CandidateBuffer polygonIds;
 
-    QList<int> crossingIds;
-    crossingIds = index->intersects(bb);
-    int crossSize = crossingIds.size();
-    
-    QList<int>::Iterator cit = crossingIds.begin();
-    QList<int>::ConstIterator crossingIdsEnd = crossingIds.end();
+  // points are grouped by their candidate polygons a chunk at a time,
+  // so that every polygon is prepared once for all its points in the chunk
+  const int chunkSize = 65536;
+  for (int chunk = 0; chunk < run->features().size(); chunk += chunkSize)
+  {
+    int chunkEnd = qMin(chunk + chunkSize, run->features().size());
+    QVector<QgsPoint> points;
+    QVector<int> owners;
+    QHash<int, QVector<int> > batches;
 
-    for (; cit != crossingIdsEnd; ++cit)
+    for (int f = chunk; f < chunkEnd; ++f)
     {
-      QgsFeature& f = mFeatureMap2[*cit].feature;
-      QgsGeometry* g2 = f.geometry();
+      if (!(++i % 100))
+        run->setProgress(i);
 
-      // skip itself, when invoked with the same layer
-      if (skipItself && f.id() == it->feature.id())
-        continue;
+      if (run->isStopped())
+        return errorList;
 
-      if (!g2)
+      QgsGeometry* g1 = run->features()[f].feature.geometry();
+      QgsMultiPoint members;
+      if (g1->wkbType() == QGis::WKBMultiPoint || g1->wkbType() == QGis::WKBMultiPoint25D)
+        members = g1->asMultiPoint();
+      else
+        members << g1->asPoint();
+
+      for (int m = 0; m < members.size(); ++m)
       {
-	std::cout << "g2 == NULL in contains\n" << std::flush;
-        continue;
+        const QgsPoint& p = members[m];
+        index->intersects(QgsRectangle(p.x(), p.y(), p.x(), p.y()), polygonIds);
+        for (int c = 0; c < polygonIds.size(); ++c)
+          batches[polygonIds[c]] << points.size();
+
+        points << p;
+        owners << f;
       }
+    }
 
-      if (!g2->asGeos())
-      {
-	std::cout << "g2->asGeos() == NULL in contains\n" << std::flush;
+    QVector<bool> covered(points.size(), false);
+    QHash<int, QVector<int> >::ConstIterator it = batches.begin();
+    for (; it != batches.end(); ++it)
+    {
+      PreparedPolygon polygon(features2[it.key()].feature.geometry());
+      const QVector<int>& batch = *it;
+      for (int b = 0; b < batch.size(); ++b)
+        if (!covered[batch[b]] && polygon.covers(points[batch[b]]))
+          covered[batch[b]] = true;
+    }
+
+    // a multipoint is reported once when any of its points lies outside
+    int reported = -1;
+    for (int p = 0; p < points.size(); ++p)
+    {
+      if (covered[p] || owners[p] == reported)
         continue;
-      }
 
-      if (geosContains(g1, g2))
-      {
-	QList<FeatureLayer> fls;
-	FeatureLayer fl;
-	fl.feature = f;
-	fl.layer = layer2;
-	fls << *it << fl;
-        QgsGeometry* conflict = new QgsGeometry(*g2);
-	TopolErrorInside* err = new TopolErrorInside(bb, conflict, fls);
+      reported = owners[p];
+      FeatureLayer& fl = run->features()[owners[p]];
+      QgsGeometry* g1 = fl.feature.geometry();
 
-	errorList << err;
-      }
+      QList<FeatureLayer> fls;
+      fls << fl << fl;
+      QgsGeometry* conflict = new QgsGeometry(*g1);
+      TopolErrorOutside* err = run->arena()->create<TopolErrorOutside>(g1->boundingBox(), conflict, fls);
+
+      run->addError(errorList, err);
     }
   }
 
   return errorList;
 }
 
-ErrorList topolTest::checkPointCoveredBySegment(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+ErrorList topolTest::checkPointCoveredBySegment(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
   int i = 0;
   ErrorList errorList;
   QString secondLayerId = layer2->getLayerID();
-  QgsSpatialIndex* index = mLayerIndexes[secondLayerId];
+  LayerData* data2 = run->layerData(secondLayerId);
+  TopolIndex* index = data2 ? data2->index : 0;
 
   if (!index)
   {
@@ -399,44 +1033,69 @@ ErrorList topolTest::checkPointCoveredBySegment(double tolerance, QgsVectorLayer
   if (layer2->geometryType() == QGis::Point)
     return errorList;
 
+  FeatureStore& features2 = data2->features;
+  CandidateBuffer crossingIds;
+
+  // coordinates of the candidate lines and rings, extracted once per feature
+  QHash<int, QList<QgsPolyline> > lines;
+
   QList<FeatureLayer>::Iterator it;
-  QList<FeatureLayer>::ConstIterator FeatureListEnd = mFeatureList1.end();
-  for (it = mFeatureList1.begin(); it != mFeatureList1.end(); ++it)
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
+  for (it = run->features().begin(); it != run->features().end(); ++it)
   {
     if (!(++i % 100))
-      emit progress(i);
+      run->setProgress(i);
 
-    if (testCancelled())
+    if (run->isStopped())
       break;
 
     QgsGeometry* g1 = it->feature.geometry();
     QgsRectangle bb = g1->boundingBox();
+    QgsRectangle frame(bb.xMinimum() - tolerance, bb.yMinimum() - tolerance, bb.xMaximum() + tolerance, bb.yMaximum() + tolerance);
 
-    QList<int> crossingIds;
-    crossingIds = index->intersects(bb);
-    int crossSize = crossingIds.size();
-    
-    QList<int>::Iterator cit = crossingIds.begin();
-    QList<int>::ConstIterator crossingIdsEnd = crossingIds.end();
+    index->intersects(frame, crossingIds);
 
-    bool touched = false;
+    QgsMultiPoint points;
+    if (g1->wkbType() == QGis::WKBMultiPoint || g1->wkbType() == QGis::WKBMultiPoint25D)
+      points = g1->asMultiPoint();
+    else
+      points << g1->asPoint();
 
-    for (; cit != crossingIdsEnd; ++cit)
+    // every point of a multipoint has to lie on some segment
+    bool touched = true;
+    for (int p = 0; p < points.size() && touched; ++p)
     {
-      QgsFeature& f = mFeatureMap2[*cit].feature;
-      QgsGeometry* g2 = f.geometry();
-
-      if (!g2 || !g2->asGeos())
+      touched = false;
+      for (int c = 0; c < crossingIds.size() && !touched; ++c)
       {
-	std::cout << "g2 or g2->asGeos() == NULL in covered\n" << std::flush;
-        continue;
-      }
+        if (!lines.contains(crossingIds[c]))
+          linearParts(features2[crossingIds[c]].feature.geometry(), lines[crossingIds[c]]);
+
+        const QList<QgsPolyline>& parts = lines[crossingIds[c]];
+        if (parts.isEmpty())
+        {
+          // no native coordinates for exotic geometry types
+          QgsGeometry* g2 = features2[crossingIds[c]].feature.geometry();
+          if (!g2)
+          {
+            std::cout << "g2 == NULL in covered\n" << std::flush;
+            continue;
+          }
+
+          QgsGeometry* point = pointGeometry(points[p]);
+          if (tolerance > 0)
+          {
+            double distance = run->geos()->distance(point, g2);
+            touched = distance >= 0 && distance <= tolerance;
+          }
+          else
+            touched = run->geos()->intersects(point, g2);
+          delete point;
+          continue;
+        }
 
-      // test if point touches other geometry
-      if (geosTouches(g1, g2))
-      {
-	touched = true;
-	break;
+        for (int k = 0; k < parts.size() && !touched; ++k)
+          touched = pointOnLine(points[p], parts[k], tolerance);
       }
     }
 
@@ -444,26 +1103,31 @@ ErrorList topolTest::checkPointCoveredBySegment(double tolerance, QgsVectorLayer
     {
       QList<FeatureLayer> fls;
       fls << *it << *it;
-      //bb.scale(10);
       QgsGeometry* conflict = new QgsGeometry(*g1);
-      TopolErrorCovered* err = new TopolErrorCovered(bb, conflict, fls);
+      TopolErrorCovered* err = run->arena()->create<TopolErrorCovered>(bb, conflict, fls);
 
-      errorList << err;
+      run->addError(errorList, err);
     }
   }
 
   return errorList;
 }
 
-ErrorList topolTest::checkSegmentLength(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+ErrorList topolTest::checkSegmentLength(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
   int i = 0;
   ErrorList errorList;
   QList<FeatureLayer>::Iterator it;
-  QList<FeatureLayer>::ConstIterator FeatureListEnd = mFeatureList1.end();
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
 
-  for (it = mFeatureList1.begin(); it != FeatureListEnd; ++it)
+  for (it = run->features().begin(); it != FeatureListEnd; ++it)
   {
+    if (!(++i % 100))
+      run->setProgress(i);
+
+    if (run->isStopped())
+      break;
+
     QgsGeometry* g1 = it->feature.geometry();
     QgsPolygon pol;
     QgsMultiPolygon mpol;
@@ -487,10 +1151,10 @@ ErrorList topolTest::checkSegmentLength(double tolerance, QgsVectorLayer* layer1
             fls << *it << *it;
 	    segm.clear();
 	    segm << ls[i-1] << ls[i];
-            QgsGeometry* conflict = QgsGeometry::fromPolyline(segm);
-            err = new TopolErrorShort(g1->boundingBox(), conflict, fls);
+            QgsGeometry* conflict = polylineGeometry(segm);
+            err = run->arena()->create<TopolErrorShort>(g1->boundingBox(), conflict, fls);
             //err = new TopolErrorShort(g1->boundingBox(), QgsGeometry::fromPolyline(segm), fls);
-            errorList << err;
+            run->addError(errorList, err);
 	  }
 	}
       break;
@@ -507,9 +1171,9 @@ ErrorList topolTest::checkSegmentLength(double tolerance, QgsVectorLayer* layer1
               fls << *it << *it;
 	      segm.clear();
 	      segm << pol[i][j-1] << pol[i][j];
-              QgsGeometry* conflict = QgsGeometry::fromPolyline(segm);
-              err = new TopolErrorShort(g1->boundingBox(), conflict, fls);
-              errorList << err;
+              QgsGeometry* conflict = polylineGeometry(segm);
+              err = run->arena()->create<TopolErrorShort>(g1->boundingBox(), conflict, fls);
+              run->addError(errorList, err);
 	    }
       break;
 
@@ -528,9 +1192,9 @@ ErrorList topolTest::checkSegmentLength(double tolerance, QgsVectorLayer* layer1
               fls << *it << *it;
 	      segm.clear();
 	      segm << ls[i-1] << ls[i];
-              QgsGeometry* conflict = QgsGeometry::fromPolyline(segm);
-              err = new TopolErrorShort(g1->boundingBox(), conflict, fls);
-              errorList << err;
+              QgsGeometry* conflict = polylineGeometry(segm);
+              err = run->arena()->create<TopolErrorShort>(g1->boundingBox(), conflict, fls);
+              run->addError(errorList, err);
 	    }
 	  }
 	}
@@ -551,9 +1215,9 @@ ErrorList topolTest::checkSegmentLength(double tolerance, QgsVectorLayer* layer1
                 fls << *it << *it;
 	        segm.clear();
 	        segm << pol[i][j-1] << pol[i][j];
-                QgsGeometry* conflict = QgsGeometry::fromPolyline(segm);
-                err = new TopolErrorShort(g1->boundingBox(), conflict, fls);
-                errorList << err;
+                QgsGeometry* conflict = polylineGeometry(segm);
+                err = run->arena()->create<TopolErrorShort>(g1->boundingBox(), conflict, fls);
+                run->addError(errorList, err);
 	      }
 	}
       break;
@@ -566,12 +1230,13 @@ ErrorList topolTest::checkSegmentLength(double tolerance, QgsVectorLayer* layer1
   return errorList;
 }
 
-ErrorList topolTest::checkIntersections(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+ErrorList topolTest::checkIntersections(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
   int i = 0;
   ErrorList errorList;
   QString secondLayerId = layer2->getLayerID();
-  QgsSpatialIndex* index = mLayerIndexes[secondLayerId];
+  LayerData* data2 = run->layerData(secondLayerId);
+  TopolIndex* index = data2 ? data2->index : 0;
 
   bool skipItself = layer1 == layer2;
 
@@ -581,28 +1246,31 @@ ErrorList topolTest::checkIntersections(double tolerance, QgsVectorLayer* layer1
     return errorList;
   }
 
+  // line networks are noded in one sweep instead of pairwise GEOS tests
+  if (layer1->geometryType() == QGis::Line && layer2->geometryType() == QGis::Line)
+    return checkLineIntersections(run, layer1, layer2);
+
+  FeatureStore& features2 = data2->features;
+  CandidateBuffer crossingIds;
+  PairKernel kernel(layer1->geometryType(), layer2->geometryType());
+
   QList<FeatureLayer>::Iterator it;
-  QList<FeatureLayer>::ConstIterator FeatureListEnd = mFeatureList1.end();
-  for (it = mFeatureList1.begin(); it != FeatureListEnd; ++it)
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
+  for (it = run->features().begin(); it != FeatureListEnd; ++it)
   {
     if (!(++i % 100))
-      emit progress(i);
+      run->setProgress(i);
 
-    if (testCancelled())
+    if (run->isStopped())
       break;
 
     QgsGeometry* g1 = it->feature.geometry();
     QgsRectangle bb = g1->boundingBox();
 
-    QList<int> crossingIds;
-    crossingIds = index->intersects(bb);
-    int crossSize = crossingIds.size();
-
-    QList<int>::Iterator cit = crossingIds.begin();
-    QList<int>::ConstIterator crossingIdsEnd = crossingIds.end();
-    for (; cit != crossingIdsEnd; ++cit)
+    index->intersects(bb, crossingIds);
+    for (int c = 0; c < crossingIds.size(); ++c)
     {
-      QgsFeature& f = mFeatureMap2[*cit].feature;
+      QgsFeature& f = features2[crossingIds[c]].feature;
       QgsGeometry* g2 = f.geometry();
 
       // skip itself, when invoked with the same layer
@@ -615,13 +1283,13 @@ ErrorList topolTest::checkIntersections(double tolerance, QgsVectorLayer* layer1
 	continue;
       }
 
-      if (g1->intersects(g2))
+      if (kernel.intersects(g1, g2, run->geos()))
       {
         QgsRectangle r = bb;
 	QgsRectangle r2 = g2->boundingBox();
 	r.combineExtentWith(&r2);
 
-	QgsGeometry* conflict = g1->intersection(g2);
+	QgsGeometry* conflict = run->geos()->intersection(g1, g2);
 	// could this for some reason return NULL?
 	if (!conflict)
           continue;
@@ -632,9 +1300,9 @@ ErrorList topolTest::checkIntersections(double tolerance, QgsVectorLayer* layer1
 	fl.feature = f;
 	fl.layer = layer2;
 	fls << *it << fl;
-	TopolErrorIntersection* err = new TopolErrorIntersection(r, conflict, fls);
+	TopolErrorIntersection* err = run->arena()->create<TopolErrorIntersection>(r, conflict, fls);
 
-	errorList << err;
+	run->addError(errorList, err);
       }
     }
   }
@@ -642,102 +1310,690 @@ ErrorList topolTest::checkIntersections(double tolerance, QgsVectorLayer* layer1
   return errorList;
 }
 
-void topolTest::fillFeatureMap(QgsVectorLayer* layer)
+// intersection points found between two lines
+class LinePairNodes
+{
+public:
+  LinePairNodes() : overlap(false), crossing(false) {}
+
+  QList<QgsPoint> points;
+  bool overlap;
+  bool crossing;
+};
+
+static bool pointLessThan(const QgsPoint& p1, const QgsPoint& p2)
+{
+  return p1.x() < p2.x() || (p1.x() == p2.x() && p1.y() < p2.y());
+}
+
+ErrorList topolTest::checkLineIntersections(TestRun* run, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
 {
-  layer->select(QgsAttributeList(), QgsRectangle());
+  int i = 0;
+  ErrorList errorList;
+  bool skipItself = layer1 == layer2;
+
+  // first layer features are group 0 and owned by their position in the list,
+  // second layer features are group 1 and owned by their store index
+  LineNoder noder(true);
+  QList<FeatureLayer>::Iterator it;
+  QList<FeatureLayer>::ConstIterator FeatureListEnd = run->features().end();
+  for (it = run->features().begin(); it != FeatureListEnd; ++it, ++i)
+  {
+    if (!(i % 100))
+      run->setProgress(i);
 
-  QgsFeature f;
-  while (layer->nextFeature(f))
+    if (run->isStopped())
+      return errorList;
+
+    noder.addGeometry(it->feature.geometry(), i, 0);
+  }
+
+  FeatureStore& features2 = run->layerData(layer2->getLayerID())->features;
+  for (int j = 0; j < features2.size(); ++j)
+    noder.addGeometry(features2[j].feature.geometry(), j, 1);
+
+  // group intersections back to the feature pairs
+  QMap<QPair<int, int>, LinePairNodes> pairs;
+  const QVector<NodedSegment>& segments = noder.segments();
+  QList<SegmentIntersection> nodes = noder.intersections();
+  QList<SegmentIntersection>::ConstIterator nit = nodes.begin();
+  for (; nit != nodes.end(); ++nit)
+  {
+    int pos1 = segments[nit->segment1].owner;
+    int pos2 = segments[nit->segment2].owner;
+
+    // skip itself, when invoked with the same layer
+    if (skipItself && run->features()[pos1].feature.id() == features2[pos2].feature.id())
+      continue;
+
+    LinePairNodes& pair = pairs[qMakePair(pos1, pos2)];
+    pair.points << nit->point;
+
+    if (nit->overlap)
+      pair.overlap = true;
+    else if (!noder.isPartEndpoint(nit->segment1, nit->point) && !noder.isPartEndpoint(nit->segment2, nit->point))
+      pair.crossing = true;
+  }
+
+  QMap<QPair<int, int>, LinePairNodes>::Iterator pit = pairs.begin();
+  for (; pit != pairs.end(); ++pit)
   {
-    if (f.geometry())
-    { 
-      mFeatureMap2[f.id()] = FeatureLayer(layer, f);
+    if (run->isStopped())
+      break;
+
+    FeatureLayer& fl1 = run->features()[pit.key().first];
+    FeatureLayer& fl2 = features2[pit.key().second];
+    QgsGeometry* g1 = fl1.feature.geometry();
+    QgsGeometry* g2 = fl2.feature.geometry();
+    LinePairNodes& pair = *pit;
+
+    QgsGeometry* conflict;
+    if (pair.overlap)
+    {
+      // shared parts of lines are left to GEOS
+      conflict = run->geos()->intersection(g1, g2);
+      if (!conflict)
+        continue;
+    }
+    else
+    {
+      QgsMultiPoint points;
+      qSort(pair.points.begin(), pair.points.end(), pointLessThan);
+      for (int k = 0; k < pair.points.size(); ++k)
+        if (!k || pair.points[k] != pair.points[k-1])
+          points << pair.points[k];
+
+      if (points.size() == 1)
+        conflict = pointGeometry(points.first());
+      else
+        conflict = multiPointGeometry(points);
     }
+
+    QgsRectangle r = g1->boundingBox();
+    QgsRectangle r2 = g2->boundingBox();
+    r.combineExtentWith(&r2);
+
+    QList<FeatureLayer> fls;
+    fls << fl1 << fl2;
+
+    if (pair.overlap || pair.crossing)
+      run->addError(errorList, run->arena()->create<TopolErrorIntersection>(r, conflict, fls));
+    else
+      run->addError(errorList, run->arena()->create<TopolErrorTouch>(r, conflict, fls));
   }
+
+  return errorList;
 }
 
-QgsSpatialIndex* topolTest::createIndex(QgsVectorLayer* layer)
+int topolTest::spillLayer(TestRun* run, QgsVectorLayer* layer, int side, PartitionJoin* join)
 {
-  QgsSpatialIndex* index = new QgsSpatialIndex();
-  layer->select(QgsAttributeList(), QgsRectangle());
+  QMutexLocker locker(mCache.providerMutex(layer->getLayerID()));
+  int count = 0;
 
-  int i = 0;
-  QgsFeature f;
-  while (layer->nextFeature(f))
+  // selected features are in memory anyway
+  if (side == 0 && run->validateType() == ValidateSelected)
   {
-    if (!(++i % 100))
-      emit progress(i);
+    QgsFeatureList flist = layer->selectedFeatures();
+    QgsCoordinateTransform transform(layer->srs(), run->workingCrs());
+    bool transformed = run->workingCrs() != layer->srs();
+
+    for (int i = 0; i < flist.size(); ++i)
+      if (flist[i].geometry())
+      {
+        if (transformed)
+          flist[i].geometry()->transform(transform);
+        join->add(side, flist[i]);
+        ++count;
+      }
+    return count;
+  }
+
+  QgsRectangle extent;
+  if (side == 0 && run->validateType() == ValidateExtent)
+    extent = run->extent();
+
+  FeatureQueue queue;
+  FeatureReader reader(layer, extent, &queue);
+  reader.setDestinationCrs(run->workingCrs());
+  reader.start();
+
+  QgsFeatureList batch;
+  while (queue.pop(batch))
+  {
+    for (int b = 0; b < batch.size(); ++b)
+      if (batch[b].geometry())
+      {
+        join->add(side, batch[b]);
+        ++count;
+      }
+
+    if (run->isStopped())
+      queue.close();
+  }
+  reader.wait();
+
+  return count;
+}
+
+QList<PartitionMatch> topolTest::joinPartition(const TestRun* run, const PartitionJoin* join, int partition, const PairKernel* kernel, JoinType type)
+{
+  QList<PartitionMatch> matches;
+  QList<PartitionFeature> first;
+  QList<PartitionFeature> second;
+  QList<QPair<int, int> > pairs;
+  join->candidates(partition, first, second, pairs);
+
+  // the partition calls GEOS through its own context, the global GEOS API is not thread-safe
+  GeosContext geos;
+
+  for (int c = 0; c < pairs.size() && !run->isStopped(); ++c)
+  {
+    const PartitionFeature& f1 = first[pairs[c].first];
+    const PartitionFeature& f2 = second[pairs[c].second];
+
+    bool found = false;
+    const GEOSGeometry* g1;
+    const GEOSGeometry* g2;
+    switch (type)
+    {
+      case JoinIntersects:
+        found = kernel->intersects(f1.geometry, f2.geometry, &geos);
+      break;
+
+      case JoinContains:
+        // features are exported once for all their pairs, keys of the second layer are negative
+        g1 = geos.geometry(pairs[c].first, f1.geometry);
+        g2 = geos.geometry(-1 - pairs[c].second, f2.geometry);
+        found = g1 && g2 && geos.contains(g1, g2);
+      break;
+
+      case JoinClose:
+        found = kernel->withinDistance(f1.geometry, f2.geometry, run->tolerance(), &geos);
+      break;
+
+      default:
+      break;
+    }
+
+    if (found)
+    {
+      PartitionMatch m;
+      m.id1 = f1.id;
+      m.id2 = f2.id;
+      m.geometry1 = *f1.geometry;
+      m.geometry2 = *f2.geometry;
+      matches << m;
+    }
+  }
+
+  for (int i = 0; i < first.size(); ++i)
+    delete first[i].geometry;
+  for (int i = 0; i < second.size(); ++i)
+    delete second[i].geometry;
 
-    if (testCancelled())
+  return matches;
+}
+
+static FeatureLayer partitionFeature(QgsVectorLayer* layer, int id, const QgsGeometry& g)
+{
+  FeatureLayer fl;
+  fl.feature.setFeatureId(id);
+  fl.feature.setGeometry(new QgsGeometry(g));
+  fl.layer = layer;
+  return fl;
+}
+
+ErrorList topolTest::checkPartitioned(TestRun* run, JoinType type, QgsVectorLayer* layer1, QgsVectorLayer* layer2)
+{
+  ErrorList errorList;
+
+  // only polygons contain other features
+  if (type == JoinContains && layer1->geometryType() != QGis::Polygon)
+    return errorList;
+
+  QgsRectangle extent = layer1->extent();
+  if (layer1->srs() != run->workingCrs())
+    extent = QgsCoordinateTransform(layer1->srs(), run->workingCrs()).transformBoundingBox(extent);
+  QgsRectangle extent2 = layer2->extent();
+  if (layer2->srs() != run->workingCrs())
+    extent2 = QgsCoordinateTransform(layer2->srs(), run->workingCrs()).transformBoundingBox(extent2);
+  extent.combineExtentWith(&extent2);
+
+  // only close features need the boxes grown to find their candidates
+  PartitionJoin join(extent, PartitionJoin::gridSide(layer1->featureCount() + layer2->featureCount()),
+                     type == JoinClose ? run->tolerance() : 0);
+  if (!join.open())
+  {
+    std::cout << "Cannot create partition directory!\n" << std::flush;
+    return errorList;
+  }
+
+  int featureCount = spillLayer(run, layer1, 0, &join);
+  spillLayer(run, layer2, 1, &join);
+  join.finish();
+  run->statistics().featureCount = featureCount;
+
+  bool skipItself = layer1 == layer2;
+  PairKernel kernel(layer1->geometryType(), layer2->geometryType());
+  int partitions = join.partitionCount();
+
+  // a few partitions are held in memory at once, one per thread
+  int wave = QThread::idealThreadCount();
+  for (int p = 0; p < partitions && !run->isStopped(); p += wave)
+  {
+    QList<QFuture<QList<PartitionMatch> > > joined;
+    for (int q = p; q < qMin(p + wave, partitions); ++q)
+      joined << QtConcurrent::run(this, &topolTest::joinPartition, (const TestRun*) run, (const PartitionJoin*) &join, q, (const PairKernel*) &kernel, type);
+
+    // all partitions of the wave are waited for, they refer to the join
+    for (int j = 0; j < joined.size(); ++j)
+    {
+      QList<PartitionMatch> matches = joined[j].result();
+
+      for (int m = 0; m < matches.size() && !run->isStopped(); ++m)
+      {
+        PartitionMatch& match = matches[m];
+
+        // skip itself, when invoked with the same layer
+        if (skipItself && match.id1 == match.id2)
+          continue;
+
+        QgsRectangle bb = match.geometry1.boundingBox();
+        QgsRectangle bb2 = match.geometry2.boundingBox();
+
+        QList<FeatureLayer> fls;
+        fls << partitionFeature(layer1, match.id1, match.geometry1) << partitionFeature(layer2, match.id2, match.geometry2);
+
+        QgsGeometry* conflict;
+        switch (type)
+        {
+          case JoinIntersects:
+            // line pairs are reported once with all their common points
+            conflict = run->geos()->intersection(&match.geometry1, &match.geometry2);
+            if (!conflict)
+              break;
+            bb.combineExtentWith(&bb2);
+            run->addError(errorList, run->arena()->create<TopolErrorIntersection>(bb, conflict, fls));
+          break;
+
+          case JoinContains:
+            conflict = new QgsGeometry(match.geometry2);
+            run->addError(errorList, run->arena()->create<TopolErrorInside>(bb, conflict, fls));
+          break;
+
+          case JoinClose:
+            conflict = new QgsGeometry(match.geometry2);
+            bb.combineExtentWith(&bb2);
+            run->addError(errorList, run->arena()->create<TopolErrorClose>(bb, conflict, fls));
+          break;
+
+          default:
+          break;
+        }
+      }
+    }
+
+    run->setProgress((qint64) qMin(p + wave, partitions) * featureCount / partitions);
+  }
+
+  return errorList;
+}
+
+LayerData* topolTest::layerData(TestRun* run, QgsVectorLayer* layer)
+{
+  QString layerId = layer->getLayerID();
+  LayerData* data = run->layerData(layerId);
+  if (data)
+    return data;
+
+  data = mCache.acquire(layer, run);
+  if (!data)
+    return 0;
+
+  run->addLayerData(layerId, data);
+  watchLayer(layer);
+
+  return data;
+}
+
+void topolTest::watchLayer(QgsVectorLayer* layer)
+{
+  // cached features and index are stale once the layer is edited
+  disconnect(layer, SIGNAL(layerModified(bool)), this, SLOT(layerModified()));
+  connect(layer, SIGNAL(layerModified(bool)), this, SLOT(layerModified()));
+}
+
+void topolTest::warmUp(const QList<QgsVectorLayer*>& layers, const QList<IndexType>& types,
+                       const QList<QgsVectorLayer*>& crsLayers, SpatialOrder order)
+{
+  stopWarmUp();
+
+  QList<TestRun*> runs;
+  QList<FeatureQueue*> features;
+  for (int i = 0; i < layers.size(); ++i)
+  {
+    // the provider of an edited layer is not read behind the user's back
+    if (layers[i]->isEditable())
+      continue;
+
+    watchLayer(layers[i]);
+    disconnect(layers[i], SIGNAL(editingStarted()), this, SLOT(stopWarmUp()));
+    connect(layers[i], SIGNAL(editingStarted()), this, SLOT(stopWarmUp()));
+
+    TestRun* run = new TestRun("Index warm-up", layers[i], 0, ValidateAll, 0, types[i], order);
+    run->setWorkingCrs(crsLayers[i]->srs());
+    if (mCache.isCached(layers[i], run))
     {
-      delete index;
-      return 0;
+      delete run;
+      continue;
     }
 
-    if (f.geometry())
-    { 
-      index->insertFeature(f);
-      mFeatureMap2[f.id()] = FeatureLayer(layer, f);
+    // the provider is read here in the GUI thread, never while the canvas renders from it;
+    // the queue takes all batches at once
+    FeatureQueue* queue = new FeatureQueue(std::numeric_limits<int>::max());
+    {
+      QMutexLocker locker(mCache.providerMutex(layers[i]->getLayerID()));
+      FeatureReader reader(layers[i], QgsRectangle(), queue);
+      reader.setDestinationCrs(run->workingCrs());
+      reader.read();
     }
+
+    runs << run;
+    features << queue;
+  }
+
+  // the first validation should not wait for ordering and indexing
+  mWarmUp = new CacheWarmUp(&mCache, runs, features);
+  mWarmUp->start(QThread::LowestPriority);
+}
+
+void topolTest::stopWarmUp()
+{
+  if (!mWarmUp)
+    return;
+
+  mWarmUp->cancel();
+  mWarmUp->wait();
+  delete mWarmUp;
+  mWarmUp = 0;
+}
+
+PlanarGraph* topolTest::layerGraph(TestRun* run, QgsVectorLayer* layer, double tolerance)
+{
+  LayerData* data = layerData(run, layer);
+  if (!data)
+    return 0;
+
+  return data->graph(tolerance);
+}
+
+void topolTest::layerModified()
+{
+  QgsVectorLayer* layer = qobject_cast<QgsVectorLayer*>(sender());
+  if (layer)
+    mCache.drop(layer->getLayerID());
+}
+
+void topolTest::attachTargets(TestRun* run, const QList<QFuture<LayerData*> >& loads, const QList<QgsVectorLayer*>& layers)
+{
+  for (int i = 0; i < loads.size(); ++i)
+  {
+    QString layerId = layers[i]->getLayerID();
+    if (run->layerData(layerId))
+      continue;
+
+    LayerData* data = loads[i].result();
+    if (!data)
+      continue;
+
+    run->addLayerData(layerId, data);
+    watchLayer(layers[i]);
+  }
+}
+
+bool topolTest::streamable(TestRun* run, const test& t)
+{
+  // ordering and sampling need all features at once
+  if (!t.perFeature || run->spatialOrder() != OrderNone || run->sampleSize())
+    return false;
+
+  // line networks and point layers are checked by sweeps over all features,
+  // one layer tests have no target layer
+  QgsVectorLayer* layer1 = run->layer1();
+  QList<QgsVectorLayer*> targets = run->targets();
+  for (int i = 0; i < targets.size(); ++i)
+  {
+    if (!targets[i])
+      continue;
+    if (t.f == &topolTest::checkIntersections &&
+        layer1->geometryType() == QGis::Line && targets[i]->geometryType() == QGis::Line)
+      return false;
+    if (t.f == &topolTest::checkCloseFeature && isPointLayer(layer1) && isPointLayer(targets[i]))
+      return false;
+  }
+
+  return true;
+}
+
+bool topolTest::checkBatch(TestRun* run, const test& t, QList<FeatureLayer>& batch, QList<ErrorList>& errors, int checked)
+{
+  QList<QgsVectorLayer*> targets = run->targets();
+  run->features() = batch;
+  batch.clear();
+
+  bool needed = false;
+  for (int i = 0; i < targets.size() && !run->isCancelled(); ++i)
+  {
+    if (run->limitReached(i))
+      continue;
+
+    run->setProgressOffset(checked * targets.size() + i * run->features().size());
+    run->setTarget(i);
+    errors[i] << (this->*(t.f))(run, run->tolerance(), run->layer1(), targets[i]);
+
+    if (!run->limitReached(i))
+      needed = true;
   }
 
-  return index;
+  run->features().clear();
+  return needed && !run->isCancelled();
 }
 
-ErrorList topolTest::runTest(QString testName, QgsVectorLayer* layer1, QgsVectorLayer* layer2, ValidateType type, double tolerance)
+ErrorList topolTest::runTest(TestRun* run)
 {
+  QString testName = run->testName();
+  QgsVectorLayer* layer1 = run->layer1();
+  QList<QgsVectorLayer*> targets = run->targets();
+  ValidateType type = run->validateType();
+  TestStatistics& stats = run->statistics();
+
   std::cout << testName.toStdString();
   ErrorList errors;
 
+  // the map is shared by the runs, it must not get new items
+  test t = mTestMap.value(testName);
+  if (!t.f)
+  {
+    std::cout << ": unknown test!\n" << std::flush;
+    return errors;
+  }
+
   if (!layer1)
   {
     std::cout << "First layer not found in registry!\n" << std::flush;
     return errors;
   }
 
-  if (!layer2 && mTestMap[testName].useSecondLayer)
+  if (targets.contains(0) && t.useSecondLayer)
   {
     std::cout << "Second layer not found in registry!\n" << std::flush;
     return errors;
   }
 
-  QString secondLayerId;
-  mFeatureList1.clear();
-  mFeatureMap2.clear();
-  QgsFeature f;
+  // layers of the partitioned join are read by the test itself, never kept in memory
+  bool partitioned = run->partitioned() && t.join != JoinNone;
+  // features checked on their own are checked as they are read, never kept in memory
+  bool streamed = !partitioned && type != ValidateSelected && streamable(run, t);
+  QList<ErrorList> streamedErrors;
+  for (int i = 0; i < targets.size(); ++i)
+    streamedErrors << ErrorList();
+  int streamedCount = 0;
+
+  QTime timer;
+  timer.start();
+
+  // the target layers are loaded and indexed while the first one is read,
+  // the run gets their data only in this thread
+  QList<QFuture<LayerData*> > targetData;
+  QList<QgsVectorLayer*> loadedTargets;
+  for (int i = 0; i < targets.size(); ++i)
+    if (targets[i] && !partitioned && !loadedTargets.contains(targets[i]))
+    {
+      targetData << QtConcurrent::run(&mCache, &LayerCache::acquire, targets[i], run);
+      loadedTargets << targets[i];
+    }
 
-  if (layer2)
+  if (!partitioned)
   {
-    secondLayerId = layer2->getLayerID();
-    if (!mLayerIndexes.contains(secondLayerId))
-      mLayerIndexes[secondLayerId] = createIndex(layer2);
-    else
-      fillFeatureMap(layer2);
-  }
+    QMutexLocker locker(mCache.providerMutex(layer1->getLayerID()));
 
-  // validate only selected features
-  if (type == ValidateSelected)
-  {
+    // validate only selected features
+    if (type == ValidateSelected)
+    {
       QgsFeatureList flist = layer1->selectedFeatures();
       QgsFeatureList::Iterator fit = flist.begin();
-      QgsFeatureList::Iterator flistEnd = flist.end();
-  
+
+      QgsCoordinateTransform transform(layer1->srs(), run->workingCrs());
+      bool transformed = run->workingCrs() != layer1->srs();
+
       for (; fit != flist.end(); ++fit)
-	if (fit->geometry())
-          mFeatureList1 << FeatureLayer(layer1, *fit);
+        if (fit->geometry())
+        {
+          if (transformed)
+            fit->geometry()->transform(transform);
+          run->features() << FeatureLayer(layer1, *fit);
+        }
+    }
+    // validate all features or the extent set by the caller
+    else
+    {
+      QgsRectangle extent;
+      if (type == ValidateExtent)
+        extent = run->extent();
+
+      // batches read so far are taken while the provider reads the next ones
+      FeatureQueue queue;
+      FeatureReader reader(layer1, extent, &queue);
+      reader.setDestinationCrs(run->workingCrs());
+      reader.start();
+
+      // read features wait in the pending list until the targets are loaded
+      QList<FeatureLayer> pending;
+      bool attached = false;
+
+      QgsFeatureList batch;
+      while (queue.pop(batch))
+      {
+        QList<FeatureLayer>& read = streamed ? pending : run->features();
+        for (int b = 0; b < batch.size(); ++b)
+          if (batch[b].geometry())
+            read << FeatureLayer(layer1, batch[b]);
+
+        bool loaded = true;
+        for (int i = 0; i < targetData.size(); ++i)
+          loaded = loaded && targetData[i].isFinished();
+
+        if (streamed && loaded)
+        {
+          if (!attached)
+            attachTargets(run, targetData, loadedTargets);
+          attached = true;
+
+          int size = pending.size();
+          if (!checkBatch(run, t, pending, streamedErrors, streamedCount))
+            queue.close();
+          streamedCount += size;
+        }
+
+        if (run->isCancelled() || (!streamed && run->isStopped()))
+          queue.close();
+      }
+      reader.wait();
+
+      // the targets took longer than the first layer
+      if (streamed && !pending.isEmpty() && !run->isCancelled())
+      {
+        attachTargets(run, targetData, loadedTargets);
+        int size = pending.size();
+        checkBatch(run, t, pending, streamedErrors, streamedCount);
+        streamedCount += size;
+      }
+    }
+  }
+
+  stats.loadTime = timer.restart();
+
+  // only the part of the target loading not hidden behind the first layer is counted
+  attachTargets(run, targetData, loadedTargets);
+  stats.indexTime = timer.restart();
+
+  // the sample is checked against the whole second layer,
+  // tests processing the whole first layer anyway check all features
+  FeatureSample sample(t.wholeLayer ? 0 : run->sampleSize());
+  sample.draw(run->features());
+
+  // neighbouring features are checked one after another
+  sortFeatures(run->features(), run->spatialOrder());
+  stats.orderTime += timer.restart();
+
+  // the features of the first layer are read once and checked against every target,
+  // every target has its own error limit
+  for (int i = 0; i < targets.size() && !run->isCancelled(); ++i)
+  {
+    ErrorList targetErrors;
+    if (streamed)
+      targetErrors = streamedErrors[i];
+    else
+    {
+      run->setProgressOffset(i * run->features().size());
+      run->setTarget(i);
+
+      //call test routine
+      targetErrors = partitioned ? checkPartitioned(run, t.join, layer1, targets[i])
+                                 : (this->*(t.f))(run, run->tolerance(), layer1, targets[i]);
+    }
+
+    // the error found after the last counted one only tells the limit was reached,
+    // the arena destroys it with the others
+    if (run->limitReached(i))
+    {
+      while (targetErrors.size() > run->maxErrors())
+        targetErrors.removeLast();
+      stats.limitReached = true;
+    }
+
+    stats.targetErrors << targetErrors.size();
+    errors << targetErrors;
   }
-  // validate all features or current extent
-  else {
-    QgsRectangle extent;
-    if (type == ValidateExtent)
-      extent = QgisApp::instance()->mapCanvas()->extent();
 
-    layer1->select(QgsAttributeList(), extent);
-    while (layer1->nextFeature(f))
-      if (f.geometry())
-        mFeatureList1 << FeatureLayer(layer1, f);
+  stats.testTime = timer.elapsed();
+  if (!partitioned)
+    stats.featureCount = streamed ? streamedCount : run->features().size();
+  stats.errorCount = errors.size();
+
+  if (sample.isSampled())
+  {
+    SampleEstimate estimate = sample.estimate(errors, layer1);
+    stats.population = sample.population();
+    stats.estimatedErrors = estimate.errors;
+    stats.errorsLow = estimate.low;
+    stats.errorsHigh = estimate.high;
   }
 
-  //call test routine
-  return (this->*(mTestMap[testName].f))(tolerance, layer1, layer2);
+  // other runs may still use the layer data
+  QList<LayerData*> data = run->takeLayerData();
+  for (int i = 0; i < data.size(); ++i)
+    mCache.release(data[i]);
+
+  return errors;
 }
@@ -18,39 +18,74 @@
 #ifndef TOPOLTEST_H
 #define TOPOLTEST_H
 
+#include <QFuture>
 #include <QObject>
 
 #include <qgsvectorlayer.h>
 #include <qgsgeometry.h>
-#include <spatialindex/qgsspatialindex.h>
-
+#include "envelopeJoin.h"
+#include "featureStore.h"
+#include "layerCache.h"
+#include "partitionJoin.h"
+#include "spatialOrder.h"
+#include "testRun.h"
 #include "topolError.h"
+#include "topolGraph.h"
+#include "topolIndex.h"
 
 class topolTest;
+class PairKernel;
 
-typedef ErrorList (topolTest::*testFunction)(double, QgsVectorLayer*, QgsVectorLayer*);
+typedef ErrorList (topolTest::*testFunction)(TestRun*, double, QgsVectorLayer*, QgsVectorLayer*);
 
-enum ValidateType { ValidateAll, ValidateExtent, ValidateSelected };
+// predicate of a two layer test that can be checked by the partitioned join
+enum JoinType
+{
+  JoinNone,
+  JoinIntersects,
+  JoinContains,
+  JoinClose
+};
 
 class test
 {
 public:
   bool useSecondLayer;
   bool useTolerance;
+  JoinType join;
+  // every feature of the first layer is checked on its own,
+  // so the features can be checked in batches as they are read
+  bool perFeature;
+  // the test processes all features of the first layer whatever features
+  // are checked, sampling would not save any work
+  bool wholeLayer;
   testFunction f;
 
   /**
    * Constructor
-   * initializes the test to use both layers and not to use the tolerance
+   * initializes the test to use both layers, not to use the tolerance,
+   * to be checked in memory only and after the first layer is read
    */
   test()
   {
     useSecondLayer = true;
     useTolerance = false;
+    join = JoinNone;
+    perFeature = false;
+    wholeLayer = false;
     f = 0;
   }
 };
 
+class TileGaps
+{
+public:
+  // uncovered areas lying inside the tile
+  QList<QgsGeometry*> gaps;
+  // uncovered areas reaching the tile border, stitched with the neighbouring tiles later
+  QList<QgsGeometry*> border;
+};
+
 class topolTest: public QObject
 {
 Q_OBJECT
@@ -64,110 +99,270 @@ public:
    */
   QMap<QString, test> testMap() { return mTestMap; }
   /**
-   * Runs the test and returns all found errors
-   * @param testName name of the test
-   * @param layer1 pointer to the first layer
-   * @param layer2 pointer to the second layer
-   * @param type type what features to validate
-   * @param tolerance possible tolerance
+   * Runs the test against all targets of the run and returns all found errors,
+   * may be called for several runs at once from different threads
+   * @param run run context with the test name, layers and parameters
    */
-  ErrorList runTest(QString testName, QgsVectorLayer* layer1, QgsVectorLayer* layer2, ValidateType type, double tolerance);
+  ErrorList runTest(TestRun* run);
+  /**
+   * Reads the layers missing in the cache and starts ordering and indexing
+   * them in a low priority thread, stopping the previous warm-up if it is still
+   * running. Called in the GUI thread, which reads the providers itself.
+   * @param layers layers used by the rules
+   * @param types index backend of every layer
+   * @param crsLayers first layers of the rules, the layers are transformed into their coordinate systems
+   * @param order order features are kept in feature stores
+   */
+  void warmUp(const QList<QgsVectorLayer*>& layers, const QList<IndexType>& types,
+              const QList<QgsVectorLayer*>& crsLayers, SpatialOrder order);
 
   /**
    * Checks for intersections of the two layers
+   * @param run run context
    * @param tolerance not used
    * @param layer1 pointer to the first layer
    * @param layer2 pointer to the second layer
    */
-  ErrorList checkIntersections(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkIntersections(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
    * Checks for self-intersections in the layer
+   * @param run run context
    * @param tolerance not used
    * @param layer1 pointer to the first layer
    * @param layer2 not used
    */
-  ErrorList checkSelfIntersections(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkSelfIntersections(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
    * Checks for features that are too close
+   * @param run run context
    * @param tolerance allowed tolerance
    * @param layer1 pointer to the first layer
    * @param layer2 pointer to the second layer
    */
-  ErrorList checkCloseFeature(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkCloseFeature(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
    * Checks for features from second layer, that are contained in features from first layer
+   * @param run run context
    * @param tolerance not used
    * @param layer1 pointer to the first layer
    * @param layer2 pointer to the second layer
    */
-  ErrorList checkPolygonContains(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkPolygonContains(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
    * Checks for short segments
+   * @param run run context
    * @param tolerance tolerance - not used
    * @param layer1 pointer to the first layer
    * @param layer2 pointer to the second layer
    */
-  ErrorList checkSegmentLength(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkSegmentLength(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
-   * Checks for dangling lines
-   * @param tolerance allowed tolerance
+   * Checks for dangling lines, whose part ends are not connected to any other feature
+   * @param run run context
+   * @param tolerance snapping distance of the graph nodes
    * @param layer1 pointer to the first layer
    * @param layer2 not used
    */
-  ErrorList checkDanglingLines(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkDanglingLines(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
-   * Checks for points not covered by any segment
+   * Checks for pseudo nodes, where exactly two lines meet end to end
+   * @param run run context
+   * @param tolerance snapping distance of the graph nodes
+   * @param layer1 pointer to the first layer
+   * @param layer2 not used
+   */
+  ErrorList checkPseudoNodes(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Checks for polygons whose interiors intersect
+   * @param run run context
    * @param tolerance not used
    * @param layer1 pointer to the first layer
+   * @param layer2 not used
+   */
+  ErrorList checkOverlaps(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Checks for holes between polygons that are not covered by any of them
+   * @param run run context
+   * @param tolerance gaps narrower than the tolerance on average are taken as slivers and skipped
+   * @param layer1 pointer to the first layer
+   * @param layer2 not used
+   */
+  ErrorList checkGaps(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Checks for features with the same geometry, regardless of ring orientation,
+   * start vertex, line direction and order of parts
+   * @param run run context
+   * @param tolerance grid size coordinates are snapped to before comparing, 0 for exact duplicates
+   * @param layer1 pointer to the first layer
+   * @param layer2 not used
+   */
+  ErrorList checkDuplicates(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Checks for points not lying inside or on the boundary of any polygon
+   * @param run run context
+   * @param tolerance not used
+   * @param layer1 pointer to the first layer
+   * @param layer2 pointer to the second layer
+   */
+  ErrorList checkPointInPolygon(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Checks for points not lying on any segment of the lines or polygon rings.
+   * Unlike the former GEOS touches test, points inside a line are covered,
+   * not only its end points.
+   * @param run run context
+   * @param tolerance allowed distance of the point from the segment, 0 for points exactly on it
+   * @param layer1 pointer to the first layer
    * @param layer2 pointer to the second layer
    */
-  ErrorList checkPointCoveredBySegment(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkPointCoveredBySegment(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
   /**
    * Checks for invalid geometries
+   * @param run run context
    * @param tolerance not used
    * @param layer1 pointer to the first layer
    * @param layer2 not used
    */
-  ErrorList checkValid(double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  ErrorList checkValid(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
 
 public slots:
   /**
-   * Checks for invalid geometries
-   * @param tolerance not used
-   * @param layer1 pointer to the first layer
-   * @param layer2 not used
+   * Stops the warm-up thread and waits for it, called before
+   * a layer it reads is removed or edited
+   */
+  void stopWarmUp();
+
+private slots:
+  /**
+   * Drops cached index of the modified layer
    */
-  void setTestCancelled();
+  void layerModified();
 
 private:
-  QMap<QString, QgsSpatialIndex*> mLayerIndexes;
+  // layer data shared by all runs
+  LayerCache mCache;
+  CacheWarmUp* mWarmUp;
   QMap<QString, test> mTestMap;
 
-  QList<FeatureLayer> mFeatureList1;
-  QMap<int, FeatureLayer> mFeatureMap2;
-  bool mTestCancelled;
-
   /**
-   * Builds spatial index for the layer
+   * Checks for intersections of two line layers by noding all their segments at once,
+   * endpoint touches are reported separately from crossings
+   * @param run run context
+   * @param layer1 pointer to the first layer
+   * @param layer2 pointer to the second layer
+   */
+  ErrorList checkLineIntersections(TestRun* run, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Finds overlapping polygons among the candidate pairs of one sweep strip,
+   * runs in a worker thread
+   * @param run run context, checked for cancellation
+   * @param join envelope join over the layer features
+   * @param features features of the layer
+   * @param begin first sorted position of the strip
+   * @param end position after the last one
+   */
+  QList<QPair<int, int> > overlapStrip(const TestRun* run, const EnvelopeJoin* join, const FeatureStore* features, int begin, int end);
+  /**
+   * Finds areas of the tile not covered by any polygon, runs in a worker thread
+   * @param run run context, checked for cancellation
+   * @param index spatial index of the layer
+   * @param features features of the layer
+   * @param tile tile rectangle
+   */
+  TileGaps gapTile(const TestRun* run, const TopolIndex* index, const FeatureStore* features, QgsRectangle tile);
+  /**
+   * Checks for points closer than the tolerance using a k-d tree
+   * over the point coordinates of the second layer
+   * @param run run context
+   * @param tolerance allowed tolerance
+   * @param layer1 pointer to the first point layer
+   * @param layer2 pointer to the second point layer
+   */
+  ErrorList checkClosePoints(TestRun* run, double tolerance, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Finds points of the range closer than the run tolerance to points of the tree,
+   * runs in a worker thread
+   * @param run run context with the tolerance, checked for cancellation
+   * @param tree k-d tree over the second layer
+   * @param points points of the first layer
+   * @param begin first point of the range
+   * @param end position after the last point
+   */
+  QList<QPair<int, int> > closePointChunk(const TestRun* run, const PointTree* tree, const QVector<QgsPoint>* points, int begin, int end);
+  /**
+   * Checks the test by the partitioned join, both layers are written to
+   * partition files on disk instead of being loaded in memory
+   * @param run run context
+   * @param type predicate of the test
+   * @param layer1 pointer to the first layer
+   * @param layer2 pointer to the second layer
+   */
+  ErrorList checkPartitioned(TestRun* run, JoinType type, QgsVectorLayer* layer1, QgsVectorLayer* layer2);
+  /**
+   * Writes features of the layer to the partitions, the first layer is read
+   * as the run validates it and the second one whole.
+   * Returns number of features written.
+   * @param run run context
    * @param layer pointer to the layer
+   * @param side 0 for the first layer, 1 for the second one
+   * @param join partitioned join
+   */
+  int spillLayer(TestRun* run, QgsVectorLayer* layer, int side, PartitionJoin* join);
+  /**
+   * Joins features of one partition and finds the pairs satisfying the predicate,
+   * runs in a worker thread
+   * @param run run context with the tolerance, checked for cancellation
+   * @param join partitioned join
+   * @param partition partition number
+   * @param kernel kernel for the geometry types of the layers
+   * @param type predicate of the test
    */
-  QgsSpatialIndex* createIndex(QgsVectorLayer* layer);
+  QList<PartitionMatch> joinPartition(const TestRun* run, const PartitionJoin* join, int partition, const PairKernel* kernel, JoinType type);
   /**
-   * Fills the feature map with features from the layer
+   * Returns cached data of the layer for the run, loading them when they
+   * are missing or were built with another index backend or ordering
+   * @param run run context, holds the data until it ends
    * @param layer pointer to the layer
    */
-  void fillFeatureMap(QgsVectorLayer* layer);
+  LayerData* layerData(TestRun* run, QgsVectorLayer* layer);
   /**
-   * Returns true if the test was cancelled
+   * Gives the run the target data loaded meanwhile, waits for them
+   * @param run run context, holds the data until it ends
+   * @param loads loads of the target data
+   * @param layers target layers in the order of the loads
    */
-  bool testCancelled();
-
-signals:
+  void attachTargets(TestRun* run, const QList<QFuture<LayerData*> >& loads, const QList<QgsVectorLayer*>& layers);
   /**
-   * Informs progress dialog about current status
-   * @param value process status
+   * Returns true if the test can check the first layer in batches as it is read:
+   * it checks every feature on its own and needs neither the whole feature list
+   * for ordering or sampling nor a sweep over all features
+   * @param run run context
+   * @param t test
+   */
+  bool streamable(TestRun* run, const test& t);
+  /**
+   * Checks a batch of the first layer against every target that did not
+   * reach its error limit yet
+   * Returns false once no target needs more features.
+   * @param run run context, the batch is its feature list during the check
+   * @param t test
+   * @param batch features read, emptied
+   * @param errors errors found against every target
+   * @param checked number of features checked before the batch
+   */
+  bool checkBatch(TestRun* run, const test& t, QList<FeatureLayer>& batch, QList<ErrorList>& errors, int checked);
+  /**
+   * Drops cached data of the layer whenever it is modified
+   * @param layer pointer to the layer
+   */
+  void watchLayer(QgsVectorLayer* layer);
+  /**
+   * Returns planar graph of the layer, building it and the layer data
+   * when they are missing
+   * @param run run context
+   * @param layer pointer to the layer
+   * @param tolerance snapping distance of the graph nodes
    */
-  void progress(int value);
+  PlanarGraph* layerGraph(TestRun* run, QgsVectorLayer* layer, double tolerance);
 };
 
 #endif
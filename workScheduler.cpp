@@ -0,0 +1,78 @@
+/***************************************************************************
+  workScheduler.cpp
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "workScheduler.h"
+
+#include <algorithm>
+
+static bool costGreaterThan(const WorkTask& a, const WorkTask& b)
+{
+  return a.cost > b.cost;
+}
+
+void WorkScheduler::add(double cost)
+{
+  mCosts << cost;
+  mTotalCost += cost;
+}
+
+QVector<WorkTask> WorkScheduler::tasks(int count) const
+{
+  QVector<WorkTask> result;
+  double target = mTotalCost / qMax(1, count);
+
+  WorkTask task;
+  task.begin = 0;
+  task.cost = 0;
+  for (int i = 0; i < mCosts.size(); ++i)
+  {
+    // an expensive item does not join the cheap ones before it
+    if (i > task.begin && task.cost + mCosts[i] > target && mCosts[i] > target / 2)
+    {
+      task.end = i;
+      result << task;
+      task.begin = i;
+      task.cost = 0;
+    }
+
+    task.cost += mCosts[i];
+    if (task.cost >= target)
+    {
+      task.end = i + 1;
+      result << task;
+      task.begin = i + 1;
+      task.cost = 0;
+    }
+  }
+
+  if (task.begin < mCosts.size())
+  {
+    task.end = mCosts.size();
+    result << task;
+  }
+
+  std::stable_sort(result.begin(), result.end(), costGreaterThan);
+  return result;
+}
+
+int WorkScheduler::progress(double done, int maximum) const
+{
+  if (mTotalCost <= 0)
+    return maximum;
+
+  return qMin(maximum, (int) (maximum * (done / mTotalCost)));
+}
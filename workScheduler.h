@@ -0,0 +1,72 @@
+/***************************************************************************
+  workScheduler.h
+  TOPOLogy checker
+  -------------------
+         date                 : May 2009
+         copyright            : Vita Cizek
+         email                : weetya (at) gmail.com
+
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef WORKSCHEDULER_H
+#define WORKSCHEDULER_H
+
+#include <QVector>
+
+class WorkTask
+{
+public:
+  // items begin..end-1
+  int begin;
+  int end;
+  // estimated cost of the items
+  double cost;
+};
+
+/**
+ * Splits items processed in a fixed order into contiguous tasks of about
+ * the same estimated cost, so that a few huge features do not make one
+ * worker run long after the others have finished.
+ */
+class WorkScheduler
+{
+public:
+  WorkScheduler() { mTotalCost = 0; }
+
+  /**
+   * Adds cost of the next item
+   * @param cost estimated cost, vertex count based
+   */
+  void add(double cost);
+  /**
+   * Returns number of items
+   */
+  int size() const { return mCosts.size(); }
+  double totalCost() const { return mTotalCost; }
+  /**
+   * Returns tasks covering all items, the most expensive first
+   * so that they do not finish last
+   * @param count wanted number of tasks, an item costing more than
+   * the average task gets a task of its own
+   */
+  QVector<WorkTask> tasks(int count) const;
+  /**
+   * Returns progress value in the range 0..maximum for the finished cost
+   * @param done cost of the finished tasks
+   * @param maximum progress value of the whole work
+   */
+  int progress(double done, int maximum) const;
+
+private:
+  QVector<double> mCosts;
+  double mTotalCost;
+};
+
+#endif